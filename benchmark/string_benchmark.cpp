@@ -0,0 +1,241 @@
+// string.h 的微基准：函数 x 输入长度 x 分隔符密度 x 字符类型。
+// 计时和统计交给 umu/benchmark.hpp，另外输出 ns/byte 和每次调用的内存分配次数，
+// --json=path 写出 JSON，--baseline=path 与以前的输出比较。
+//   cmake -S benchmark -B build/benchmark
+//   cmake --build build/benchmark --config Release
+//   umu_string_benchmark [--filter=Split] [--min-time=0.1] [--json=path]
+// 只用到可移植的头文件，Linux/Windows 都可以编译
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "umu/benchmark.hpp"
+#include "umu/string.h"
+
+namespace {
+size_t g_allocation_count = 0;
+}  // namespace
+
+// 统计全局分配次数，基准是单线程的。
+// GCC 把替换后的 new/delete 内联进容器代码后会误报 malloc/free 不配对
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(std::size_t size) {
+  ++g_allocation_count;
+  if (void* p = std::malloc(0 == size ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  std::free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+using umu::benchmark::DoNotOptimize;
+
+template <typename CharType>
+constexpr const char* CharTypeName() {
+  return sizeof(CharType) == sizeof(char) ? "char" : "wchar_t";
+}
+
+// 小写字母中随机插入 ','，平均每 density 个字符一个
+template <typename CharType>
+std::basic_string<CharType> MakeInput(size_t size, size_t density) {
+  std::mt19937 engine(static_cast<uint32_t>(size * 131 + density));
+  std::uniform_int_distribution<int> letter('a', 'z');
+  std::uniform_int_distribution<size_t> separator(0, density - 1);
+  std::basic_string<CharType> s(size, CharType());
+  for (auto& c : s) {
+    c = static_cast<CharType>(0 == separator(engine) ? ',' : letter(engine));
+  }
+  return s;
+}
+
+template <typename CharType>
+std::basic_string<CharType> Widen(std::string_view s) {
+  return std::basic_string<CharType>(s.begin(), s.end());
+}
+
+// umu::benchmark::Runner 只统计耗时，这里另外记下每个用例处理的字节数，
+// 跑完后按 mean 算 ns/byte，再单独调用一次数内存分配
+class Suite {
+ public:
+  Suite() { runner_.options().min_time = 0.1; }
+
+  template <class Function>
+  void Run(const std::string& name, size_t bytes, Function fn) {
+    runner_.Add(name, fn);
+    cases_.emplace(name, Case{bytes, fn});
+  }
+
+  int Main(int argc, char* argv[]) {
+    const int status = runner_.Main(argc, argv);
+    if (2 != status) {
+      PrintThroughput();
+    }
+    return status;
+  }
+
+ private:
+  struct Case {
+    size_t bytes;
+    std::function<void()> fn;
+  };
+
+  void PrintThroughput() const {
+    std::printf("\n%-44s %9s %9s %9s\n", "name/type/size[/density]", "bytes",
+                "ns/byte", "allocs");
+    for (const umu::benchmark::Result& result : runner_.results()) {
+      const Case& c = cases_.at(result.name);
+      // 预热之后的一次调用，容器容量已经够用
+      const size_t allocations = g_allocation_count;
+      c.fn();
+      std::printf("%-44s %9zu %9.3f %9zu\n", result.name.c_str(), c.bytes,
+                  0 == c.bytes ? 0 : result.mean / c.bytes,
+                  g_allocation_count - allocations);
+    }
+  }
+
+  umu::benchmark::Runner runner_;
+  std::map<std::string, Case> cases_;
+};
+
+template <typename CharType>
+void RunStringBenchmarks(Suite* suite) {
+  using StringType = std::basic_string<CharType>;
+  using ViewType = std::basic_string_view<CharType>;
+  const char* const type_name = CharTypeName<CharType>();
+  const StringType separator = Widen<CharType>(",");
+  const StringType any_of = Widen<CharType>(",;");
+  const StringType find = Widen<CharType>("a,");
+  const StringType same_size = Widen<CharType>("b;");
+  const StringType longer = Widen<CharType>("b;;");
+
+  // 用例在 Suite::Main 里才运行，输入和工作区放在堆上，由闭包共享
+  struct Input {
+    StringType source;
+    std::vector<StringType> fields;
+    std::vector<ViewType> views;
+    StringType work;
+  };
+
+  for (const size_t size : {64, 1024, 16 * 1024, 256 * 1024}) {
+    for (const size_t density : {4, 32}) {
+      const auto input = std::make_shared<Input>();
+      input->source = MakeInput<CharType>(size, density);
+      // 会修改输入的函数每次先 assign 一份，容量足够时不分配
+      input->work.reserve(2 * size);
+      const size_t bytes = size * sizeof(CharType);
+      char suffix[64];
+      std::snprintf(suffix, sizeof(suffix), "/%s/%zu/%zu", type_name, size,
+                    density);
+
+      suite->Run(std::string("Split(string)") + suffix, bytes, [=] {
+        DoNotOptimize(
+            umu::string::Split(&input->fields, input->source, separator));
+      });
+      suite->Run(std::string("Split(char)") + suffix, bytes, [=] {
+        DoNotOptimize(
+            umu::string::Split(&input->fields, input->source, separator[0]));
+      });
+      suite->Run(std::string("SplitAnyOf") + suffix, bytes, [=] {
+        DoNotOptimize(
+            umu::string::SplitAnyOf(&input->fields, input->source, any_of));
+      });
+      suite->Run(std::string("SplitView") + suffix, bytes, [=] {
+        DoNotOptimize(
+            umu::string::SplitView(&input->views, input->source, separator[0]));
+      });
+      suite->Run(std::string("Replace(char)") + suffix, bytes, [=] {
+        input->work.assign(input->source);
+        DoNotOptimize(
+            umu::string::Replace(input->work, CharType(','), CharType(';')));
+      });
+      suite->Run(std::string("Replace(same size)") + suffix, bytes, [=] {
+        input->work.assign(input->source);
+        DoNotOptimize(umu::string::Replace(input->work, find, same_size));
+      });
+      suite->Run(std::string("Replace(longer)") + suffix, bytes, [=] {
+        input->work.assign(input->source);
+        DoNotOptimize(umu::string::Replace(input->work, find, longer));
+      });
+    }
+
+    // Trim 的开销在两端，中间不含空格
+    const auto input = std::make_shared<Input>();
+    input->source.assign(16, CharType(' '));
+    input->source += MakeInput<CharType>(size, 32);
+    input->source.append(16, CharType(' '));
+    input->work.reserve(input->source.size());
+    char suffix[64];
+    std::snprintf(suffix, sizeof(suffix), "/%s/%zu", type_name, size);
+    suite->Run(std::string("Trim") + suffix,
+               input->source.size() * sizeof(CharType), [=] {
+                 input->work.assign(input->source);
+                 DoNotOptimize(umu::string::Trim(input->work));
+               });
+  }
+
+  // ArrayJoin 的元素个数是编译期常量，array 指向 source
+  const auto join = [&](auto count) {
+    constexpr size_t kCount = decltype(count)::value;
+    const auto input = std::make_shared<Input>();
+    input->source = MakeInput<CharType>(kCount * 16, 1024);
+    const auto array = std::make_shared<std::array<ViewType, kCount>>();
+    size_t bytes = 0;
+    for (size_t i = 0; i < kCount; ++i) {
+      (*array)[i] = ViewType(input->source).substr(i * 16, 1 + i % 16);
+      bytes += (*array)[i].size() * sizeof(CharType);
+    }
+    char name[64];
+    std::snprintf(name, sizeof(name), "ArrayJoin/%s/%zu", type_name, kCount);
+    suite->Run(name, bytes, [input, array] {
+      DoNotOptimize(umu::string::ArrayJoin(*array));
+    });
+  };
+  join(std::integral_constant<size_t, 8>());
+  join(std::integral_constant<size_t, 64>());
+  join(std::integral_constant<size_t, 512>());
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Suite suite;
+  RunStringBenchmarks<char>(&suite);
+  RunStringBenchmarks<wchar_t>(&suite);
+  return suite.Main(argc, argv);
+}
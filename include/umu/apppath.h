@@ -1,55 +1,111 @@
 ﻿#pragma once
 
 #include <Windows.h>
+#include "program_path.hpp"
+#include "string.h"
 #include "tstring.h"
 
 namespace umu::apppath {
 
+// module_handle 为 nullptr 时使用 ProgramPaths::Current() 的缓存，
+// 不再调用系统 API；热路径上可以直接用 ProgramPaths 返回的 view
 inline tstring GetProgramPath(HMODULE module_handle = nullptr) {
-  tstring program_path;
-  for (DWORD buffer_size = MAX_PATH;; buffer_size += MAX_PATH) {
-    program_path.resize(buffer_size);
-    DWORD size =
-        ::GetModuleFileName(module_handle, program_path.data(), buffer_size);
+  if (nullptr == module_handle) {
+    return tstring(ProgramPaths::Current().path());
+  }
+  return tstring(ProgramPaths(module_handle).path());
+}
+
+// 返回的路径最后有带 '\'
+inline tstring GetProgramDirectory(HMODULE module_handle = nullptr) {
+  if (nullptr == module_handle) {
+    return tstring(ProgramPaths::Current().directory());
+  }
+  return tstring(ProgramPaths(module_handle).directory());
+}
+
+inline tstring GetProgramBaseName(HMODULE module_handle = nullptr) {
+  if (nullptr == module_handle) {
+    return tstring(ProgramPaths::Current().base_name());
+  }
+  return tstring(ProgramPaths(module_handle).base_name());
+}
+
+// bin 不区分大小写
+inline tstring GetProductDirectory(HMODULE module_handle = nullptr) {
+  if (nullptr == module_handle) {
+    return tstring(ProgramPaths::Current().product_directory());
+  }
+  return tstring(ProgramPaths(module_handle).product_directory());
+}
+
+// 以下重载把结果写入 inplace_basic_string，路径在容量以内时不分配内存。
+// error 策略下放不下时返回 false，result 为空且 overflow() 为 true
+template <size_t N, class Policy>
+inline bool GetProgramPath(inplace_basic_string<TCHAR, N, Policy>* program_path,
+                           HMODULE module_handle = nullptr) {
+  program_path->clear();
+  if (nullptr == module_handle) {
+    program_path->assign(ProgramPaths::Current().path());
+    return !program_path->overflow();
+  }
+  for (;;) {
+    program_path->resize_for_overwrite(program_path->capacity());
+    const auto buffer_size = static_cast<DWORD>(program_path->capacity() + 1);
+    // 之后要看截断时的错误码，先清掉之前的
+    ::SetLastError(ERROR_SUCCESS);
+    const DWORD size = ::GetModuleFileName(module_handle, program_path->data(),
+                                           buffer_size);
     if (0 == size) {
-      program_path.clear();
-      return program_path;
+      program_path->resize(0);
+      return false;
     }
-
     if (size < buffer_size) {
-      program_path.resize(size);
-      return program_path;
+      program_path->resize(size);
+      return true;
     }
-
-    if (ERROR_INSUFFICIENT_BUFFER != ::GetLastError()) {
-      program_path.clear();
-      return program_path;
+    if (ERROR_INSUFFICIENT_BUFFER != ::GetLastError() &&
+        ERROR_SUCCESS != ::GetLastError()) {
+      program_path->resize(0);
+      return false;
+    }
+    if (!program_path->reserve(program_path->capacity() * 2)) {
+      program_path->resize(0);
+      return false;
     }
   }
 }
 
-// 返回的路径最后有带 '\'
-inline tstring GetProgramDirectory(HMODULE module_handle = nullptr) {
-  tstring program_path(GetProgramPath(module_handle));
-  program_path.resize(program_path.rfind(_T('\\')) + 1);
-  return program_path;
+template <size_t N, class Policy>
+inline bool GetProgramDirectory(inplace_basic_string<TCHAR, N, Policy>* directory,
+                                HMODULE module_handle = nullptr) {
+  if (!GetProgramPath(directory, module_handle)) {
+    return false;
+  }
+  directory->resize(directory->size() - path::FileName(directory->view()).size());
+  return true;
 }
 
-inline tstring GetProgramBaseName(HMODULE module_handle = nullptr) {
-  tstring program_path(GetProgramPath(module_handle));
-  return program_path.substr(program_path.rfind(_T('\\')) + 1);
+template <size_t N, class Policy>
+inline bool GetProgramBaseName(inplace_basic_string<TCHAR, N, Policy>* base_name,
+                               HMODULE module_handle = nullptr) {
+  if (!GetProgramPath(base_name, module_handle)) {
+    return false;
+  }
+  base_name->erase(0, base_name->size() -
+                          path::FileName(base_name->view()).size());
+  return true;
 }
 
-inline tstring GetProductDirectory(HMODULE module_handle = nullptr) {
-  tstring path(GetProgramDirectory(module_handle));
-  // bin 区分大小写
-  size_t pos = path.rfind(_T("\\bin\\"));
-  if (std::string::npos == pos) {
-    // Parent Directory
-    pos = path.rfind(L'\\', path.size() - 2);
-  }
-  path.resize(pos + 1);
-  return path;
+template <size_t N, class Policy>
+inline bool GetProductDirectory(
+    inplace_basic_string<TCHAR, N, Policy>* directory,
+    HMODULE module_handle = nullptr) {
+  if (!GetProgramDirectory(directory, module_handle)) {
+    return false;
+  }
+  directory->resize(ProgramPaths::ProductDirectorySize(directory->view()));
+  return true;
 }
 
 }  // namespace umu::apppath
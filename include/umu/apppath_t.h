@@ -2,6 +2,8 @@
 
 #include <psapi.h>
 
+#include "string.h"
+
 
 namespace umu {
 namespace apppath_t {
@@ -41,9 +43,10 @@ inline CString GetProgramBaseName(HMODULE module_handle = nullptr) {
 inline CString GetProductDirectory(HMODULE module_handle = nullptr) {
   CString path(GetProgramDirectory(module_handle));
   // bin 不区分大小写
-  LPTSTR found(StrRStrI(path, nullptr, _T("\\bin\\")));
-  if (nullptr != found) {
-    path.Truncate(static_cast<int>(found - path) + 1);
+  const size_t found = string::IRFind(
+      std::basic_string_view<TCHAR>(path, path.GetLength()), _T("\\bin\\"));
+  if (std::basic_string_view<TCHAR>::npos != found) {
+    path.Truncate(static_cast<int>(found) + 1);
   } else {
     int backslash_count(0);
     for (int pos = path.GetLength() - 1; pos > 0; --pos) {
@@ -84,5 +87,31 @@ inline CString GetModuleBaseName(HANDLE process, HMODULE module = nullptr) {
     }
   }
 }
+// 写入 inplace_basic_string，名字在容量以内时不分配内存
+template <size_t N, class Policy>
+inline bool GetModuleBaseName(inplace_basic_string<TCHAR, N, Policy>* name,
+                              HANDLE process,
+                              HMODULE module = nullptr) {
+  name->clear();
+  for (;;) {
+    name->resize_for_overwrite(name->capacity());
+    const auto buffer_size = static_cast<DWORD>(name->capacity() + 1);
+    const DWORD size =
+        ::GetModuleBaseName(process, module, name->data(), buffer_size);
+    if (0 == size) {
+      name->resize(0);
+      return false;
+    }
+    // 截断时不设置错误码，正好占满容量和被截断分不出来，都加倍重试
+    if (size < buffer_size - 1) {
+      name->resize(size);
+      return true;
+    }
+    if (!name->reserve(name->capacity() * 2)) {
+      name->resize(0);
+      return false;
+    }
+  }
+}
 }  // end of namespace apppath
 }  // end of namespace umu
@@ -0,0 +1,489 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+
+#include "encoding.h"
+#else
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+// 异步控制台输出：Write 把带颜色的片段放进有界无锁 MPSC 环形队列，
+// 后台线程批量取出，合并成大块写入，调用线程不做系统调用（只在后台线程睡眠时唤醒它）。
+//   auto& out = umu::console::AsyncWriter::Output();
+//   out.Write(umu::console::kRed | umu::console::kIntensity, "error: ");
+//   out.Write("disk full\n");
+//   out.Flush();  // 等待之前的内容都已写出
+// 颜色沿用 Windows 控制台属性的位定义（和 ColorWrite 的 color 参数相同），
+// 终端和管道用 ANSI 转义序列，旧版 Windows 控制台用 SetConsoleTextAttribute。
+// 文本按 UTF-8 处理
+namespace umu {
+namespace console {
+using Color = uint16_t;
+
+constexpr Color kBlue = 0x0001;
+constexpr Color kGreen = 0x0002;
+constexpr Color kRed = 0x0004;
+constexpr Color kIntensity = 0x0008;
+constexpr Color kCyan = kBlue | kGreen;
+constexpr Color kMagenta = kBlue | kRed;
+constexpr Color kYellow = kGreen | kRed;
+constexpr Color kWhite = kBlue | kGreen | kRed;
+// 背景色是前景色左移 4 位，例如 kRed << 4
+constexpr Color kDefaultColor = 0xFFFF;
+
+enum class ColorMode : uint8_t {
+  kAuto,               // 终端用 kAnsi（或 kConsoleAttributes），其它用 kPlain
+  kAnsi,               // ANSI 转义序列，管道接 less -R 等时可以强制使用
+  kConsoleAttributes,  // 仅 Windows 控制台
+  kPlain,              // 丢弃颜色
+};
+
+// 队列满时的处理
+enum class FullPolicy : uint8_t {
+  kBlock,  // 等待后台线程腾出空间
+  kDrop,   // 丢弃这次 Write，计入 dropped()
+};
+
+struct AsyncWriterOptions {
+  // 队列槽数，向上取 2 的幂，每个槽存 AsyncWriter::kSlotTextSize 字节
+  size_t slot_count = 4096;
+  // 后台线程攒够这么多字节就写一次
+  size_t batch_size = 64 * 1024;
+  FullPolicy full_policy = FullPolicy::kBlock;
+  ColorMode color_mode = ColorMode::kAuto;
+};
+
+class AsyncWriter {
+ public:
+#if defined(_WIN32)
+  using Handle = HANDLE;
+#else
+  using Handle = int;
+#endif
+
+  // 单个槽的文本容量，更长的文本占用多个连续的槽
+  static constexpr size_t kSlotTextSize = 116;
+
+  explicit AsyncWriter(Handle output, const AsyncWriterOptions& options = {})
+      : output_(output),
+        batch_size_(std::max<size_t>(options.batch_size, kSlotTextSize)),
+        full_policy_(options.full_policy) {
+    size_t slot_count = 2;
+    while (slot_count < options.slot_count) {
+      slot_count *= 2;
+    }
+    mask_ = slot_count - 1;
+    slots_.reset(new Slot[slot_count]);
+    for (size_t i = 0; i < slot_count; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    color_mode_ = ResolveColorMode(options.color_mode);
+    batch_.reserve(batch_size_ + kSlotTextSize + 32);
+    thread_ = std::thread(&AsyncWriter::Run, this);
+  }
+
+  // 输出剩余内容后退出后台线程，此时不能再有其它线程调用 Write
+  ~AsyncWriter() {
+    stop_.store(true, std::memory_order_release);
+    Wake(true);
+    thread_.join();
+  }
+
+  // 标准输出和标准错误，首次调用时创建
+  static AsyncWriter& Output() {
+#if defined(_WIN32)
+    static AsyncWriter writer(::GetStdHandle(STD_OUTPUT_HANDLE));
+#else
+    static AsyncWriter writer(STDOUT_FILENO);
+#endif
+    return writer;
+  }
+
+  static AsyncWriter& ErrorOutput() {
+#if defined(_WIN32)
+    static AsyncWriter writer(::GetStdHandle(STD_ERROR_HANDLE));
+#else
+    static AsyncWriter writer(STDERR_FILENO);
+#endif
+    return writer;
+  }
+
+  bool Write(std::string_view text) { return Write(kDefaultColor, text); }
+
+  // 队列容量以内的文本整体入队，不会和其它线程的输出交错；
+  // 超过容量时分几次入队。kDrop 策略下队列满时返回 false
+  bool Write(Color color, std::string_view text) {
+    const size_t max_slots = mask_ + 1;
+    while (!text.empty()) {
+      const size_t slot_count =
+          std::min((text.size() + kSlotTextSize - 1) / kSlotTextSize,
+                   max_slots);
+      uint64_t position;
+      if (!Claim(slot_count, &position)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      for (size_t i = 0; i < slot_count; ++i) {
+        Slot& slot = slots_[(position + i) & mask_];
+        const size_t size = std::min(text.size(), kSlotTextSize);
+        slot.color = color;
+        slot.size = static_cast<uint16_t>(size);
+        std::memcpy(slot.text, text.data(), size);
+        text.remove_prefix(size);
+        slot.sequence.store(position + i + 1, std::memory_order_release);
+      }
+      Wake(false);
+    }
+    return true;
+  }
+
+  // 等待调用前已入队的内容都写出
+  void Flush() {
+    const uint64_t target = enqueue_position_.load(std::memory_order_acquire);
+    Wake(true);
+    std::unique_lock<std::mutex> lock(mutex_);
+    flushed_.wait(lock, [this, target] {
+      return target <= written_position_.load(std::memory_order_acquire);
+    });
+  }
+
+  // kDrop 策略下丢弃的 Write 次数
+  [[nodiscard]] uint64_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] ColorMode color_mode() const noexcept { return color_mode_; }
+
+ private:
+  // 每个槽的 sequence：等于 position 时空闲，等于 position + 1 时已写入，
+  // 读出后加上槽数留给下一圈（Vyukov 有界队列）
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> sequence;
+    Color color;
+    uint16_t size;
+    char text[kSlotTextSize];
+  };
+  static_assert(128 == sizeof(Slot));
+
+  // 连续占用 count 个槽。后台线程按顺序释放，最后一个槽空闲时前面的也都空闲
+  bool Claim(size_t count, uint64_t* position) {
+    uint64_t current = enqueue_position_.load(std::memory_order_relaxed);
+    for (uint32_t retry = 0;;) {
+      const uint64_t last = current + count - 1;
+      const uint64_t sequence =
+          slots_[last & mask_].sequence.load(std::memory_order_acquire);
+      if (sequence == last) {
+        if (enqueue_position_.compare_exchange_weak(
+                current, current + count, std::memory_order_relaxed)) {
+          *position = current;
+          return true;
+        }
+      } else if (sequence < last) {
+        // 满了，先确认不是 current 过期
+        const uint64_t latest =
+            enqueue_position_.load(std::memory_order_relaxed);
+        if (latest != current) {
+          current = latest;
+          continue;
+        }
+        if (FullPolicy::kDrop == full_policy_) {
+          return false;
+        }
+        Wake(true);
+        Backoff(&retry);
+        current = enqueue_position_.load(std::memory_order_relaxed);
+      } else {
+        current = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  static void Backoff(uint32_t* retry) {
+    if (++*retry < 64) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  // 只在后台线程睡眠时加锁通知，force 用于 Flush、析构和队列满
+  void Wake(bool force) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (force || sleeping_.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      wake_.notify_one();
+    }
+  }
+
+  [[nodiscard]] bool HasPending() const noexcept {
+    return slots_[dequeue_position_ & mask_].sequence.load(
+               std::memory_order_acquire) == dequeue_position_ + 1;
+  }
+
+  void Run() {
+    for (;;) {
+      while (HasPending()) {
+        Slot& slot = slots_[dequeue_position_ & mask_];
+        Append(slot.color, std::string_view(slot.text, slot.size));
+        slot.sequence.store(dequeue_position_ + mask_ + 1,
+                            std::memory_order_release);
+        ++dequeue_position_;
+        if (batch_size_ <= batch_.size()) {
+          WriteBatch();
+        }
+      }
+      WriteBatch();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        written_position_.store(dequeue_position_, std::memory_order_release);
+        flushed_.notify_all();
+      }
+      if (stop_.load(std::memory_order_acquire) &&
+          enqueue_position_.load(std::memory_order_acquire) ==
+              dequeue_position_) {
+        break;
+      }
+      sleeping_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // 超时只是保险，正常情况下由 Wake 唤醒
+        wake_.wait_for(lock, std::chrono::milliseconds(100), [this] {
+          return HasPending() || stop_.load(std::memory_order_acquire);
+        });
+      }
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  void Append(Color color, std::string_view text) {
+    if (color != current_color_) {
+      if (ColorMode::kAnsi == color_mode_) {
+        AppendAnsiColor(color);
+      }
+#if defined(_WIN32)
+      if (ColorMode::kConsoleAttributes == color_mode_) {
+        runs_.push_back({batch_.size(), color});
+      }
+#endif
+      current_color_ = color;
+    }
+    batch_.append(text);
+  }
+
+  // 前景 30-37（高亮 90-97），背景 40-47（高亮 100-107）；
+  // Windows 属性位是 BGR，ANSI 颜色编号是 RGB
+  void AppendAnsiColor(Color color) {
+    if (kDefaultColor == color) {
+      batch_.append("\x1b[0m");
+      return;
+    }
+    const auto ansi = [](unsigned bits) {
+      return ((bits & kRed) ? 1U : 0U) | ((bits & kGreen) ? 2U : 0U) |
+             ((bits & kBlue) ? 4U : 0U);
+    };
+    char sequence[16] = "\x1b[0;";
+    size_t size = 4;
+    const unsigned foreground = color & 0x0F;
+    const unsigned background = (color >> 4) & 0x0F;
+    if (foreground & kIntensity) {
+      sequence[size++] = '9';
+    } else {
+      sequence[size++] = '3';
+    }
+    sequence[size++] = static_cast<char>('0' + ansi(foreground));
+    if (0 != background) {
+      sequence[size++] = ';';
+      if (background & kIntensity) {
+        sequence[size++] = '1';
+        sequence[size++] = '0';
+      } else {
+        sequence[size++] = '4';
+      }
+      sequence[size++] = static_cast<char>('0' + ansi(background));
+    }
+    sequence[size++] = 'm';
+    batch_.append(sequence, size);
+  }
+
+  void WriteBatch() {
+    // 每批结束时恢复默认颜色，不影响其它方式写入的内容
+    if (kDefaultColor != current_color_) {
+      Append(kDefaultColor, std::string_view());
+    }
+    if (batch_.empty()) {
+      return;
+    }
+#if defined(_WIN32)
+    if (ColorMode::kConsoleAttributes == color_mode_) {
+      size_t offset = 0;
+      for (const Run& run : runs_) {
+        WriteOutput(std::string_view(batch_).substr(offset,
+                                                    run.offset - offset));
+        ::SetConsoleTextAttribute(
+            output_, kDefaultColor == run.color ? default_attributes_
+                                                : run.color);
+        offset = run.offset;
+      }
+      WriteOutput(std::string_view(batch_).substr(offset));
+      runs_.clear();
+      batch_.clear();
+      return;
+    }
+#endif
+    WriteOutput(batch_);
+    batch_.clear();
+  }
+
+#if defined(_WIN32)
+  ColorMode ResolveColorMode(ColorMode mode) {
+    DWORD console_mode;
+    is_console_ = FALSE != ::GetConsoleMode(output_, &console_mode);
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (is_console_ && ::GetConsoleScreenBufferInfo(output_, &csbi)) {
+      default_attributes_ = csbi.wAttributes;
+    }
+    if (ColorMode::kConsoleAttributes == mode) {
+      return is_console_ ? mode : ColorMode::kPlain;
+    }
+    if (ColorMode::kPlain == mode ||
+        (ColorMode::kAuto == mode &&
+         (!is_console_ || nullptr != std::getenv("NO_COLOR")))) {
+      return ColorMode::kPlain;
+    }
+    // Windows 10 以后的控制台支持 ANSI，省掉 SetConsoleTextAttribute
+    if (!is_console_ ||
+        ::SetConsoleMode(output_, console_mode |
+                                      ENABLE_VIRTUAL_TERMINAL_PROCESSING)) {
+      return ColorMode::kAnsi;
+    }
+    return ColorMode::kAuto == mode ? ColorMode::kConsoleAttributes
+                                    : ColorMode::kAnsi;
+  }
+
+  // 控制台用 WriteConsoleW，不受代码页影响；被截断的 UTF-8 序列留到下一批
+  void WriteOutput(std::string_view text) {
+    if (text.empty()) {
+      return;
+    }
+    if (!is_console_) {
+      while (!text.empty()) {
+        DWORD count;
+        if (!::WriteFile(output_, text.data(),
+                         static_cast<DWORD>(std::min<size_t>(text.size(),
+                                                             0x40000000)),
+                         &count, nullptr)) {
+          return;
+        }
+        text.remove_prefix(count);
+      }
+      return;
+    }
+    pending_utf8_.append(text);
+    const size_t complete = CompleteUtf8Size(pending_utf8_);
+    if (encoding::Utf8ToWide(std::string_view(pending_utf8_.data(), complete),
+                             &wide_)) {
+      DWORD count;
+      ::WriteConsoleW(output_, wide_.data(), static_cast<DWORD>(wide_.size()),
+                      &count, nullptr);
+    }
+    pending_utf8_.erase(0, complete);
+  }
+
+  // 去掉末尾不完整的 UTF-8 序列后的长度
+  static size_t CompleteUtf8Size(std::string_view text) noexcept {
+    for (size_t back = 1; back <= 4 && back <= text.size(); ++back) {
+      const auto c = static_cast<uint8_t>(text[text.size() - back]);
+      if (0x80 != (c & 0xC0)) {
+        const size_t length = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        return length <= back ? text.size() : text.size() - back;
+      }
+    }
+    return text.size();
+  }
+#else
+  ColorMode ResolveColorMode(ColorMode mode) const {
+    if (ColorMode::kConsoleAttributes == mode) {
+      return ColorMode::kAnsi;
+    }
+    if (ColorMode::kAuto != mode) {
+      return mode;
+    }
+    const char* term = std::getenv("TERM");
+    if (1 != isatty(output_) || nullptr != std::getenv("NO_COLOR") ||
+        (nullptr != term && 0 == std::strcmp(term, "dumb"))) {
+      return ColorMode::kPlain;
+    }
+    return ColorMode::kAnsi;
+  }
+
+  void WriteOutput(std::string_view text) {
+    while (!text.empty()) {
+      const ssize_t count = write(output_, text.data(), text.size());
+      if (count < 0) {
+        if (EINTR == errno) {
+          continue;
+        }
+        return;
+      }
+      text.remove_prefix(static_cast<size_t>(count));
+    }
+  }
+#endif
+
+  // 生产者共享
+  alignas(64) std::atomic<uint64_t> enqueue_position_{0};
+  std::atomic<uint64_t> dropped_{0};
+  // 后台线程独占
+  alignas(64) uint64_t dequeue_position_ = 0;
+  Color current_color_ = kDefaultColor;
+  std::string batch_;
+#if defined(_WIN32)
+  struct Run {
+    size_t offset;
+    Color color;
+  };
+  std::vector<Run> runs_;
+  std::string pending_utf8_;
+  std::wstring wide_;
+  bool is_console_ = false;
+  WORD default_attributes_ = kWhite;
+#endif
+
+  alignas(64) std::atomic<uint64_t> written_position_{0};
+  std::atomic<bool> sleeping_{false};
+  std::atomic<bool> stop_{false};
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable flushed_;
+
+  Handle output_;
+  size_t batch_size_;
+  FullPolicy full_policy_;
+  ColorMode color_mode_ = ColorMode::kPlain;
+  size_t mask_ = 0;
+  std::unique_ptr<Slot[]> slots_;
+  std::thread thread_;
+
+  AsyncWriter(const AsyncWriter&) = delete;
+  AsyncWriter& operator=(const AsyncWriter&) = delete;
+};
+}  // end of namespace console
+}  // end of namespace umu
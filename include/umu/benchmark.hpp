@@ -0,0 +1,415 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "time_measure.hpp"
+
+// 只有头文件的统计型微基准：
+//   int main(int argc, char* argv[]) {
+//     umu::benchmark::Runner runner;
+//     runner.Add("Split", [&] { umu::benchmark::DoNotOptimize(Split(...)); });
+//     return runner.Main(argc, argv);
+//   }
+// 每个用例先预热，再自动选择每个样本的迭代次数，按 Tukey 栅栏剔除离群样本，
+// 报告均值的 95% 置信区间。--baseline 读取以前 --json 的输出，
+// 置信区间不重叠且变化超过阈值时判为回退，Main 返回 1
+namespace umu {
+namespace benchmark {
+template <typename T>
+inline void DoNotOptimize(const T& value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &value;
+#endif
+}
+
+inline void ClobberMemory() noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : : "memory");
+#else
+  _ReadWriteBarrier();
+#endif
+}
+
+// 当前线程绑定到 cpu，失败或平台不支持时返回 false
+inline bool PinToCpu(int cpu) noexcept {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+  return 0 != SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << cpu);
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+struct Options {
+  // 每个用例的计时总时长，秒
+  double min_time = 0.5;
+  double warmup_time = 0.1;
+  int sample_count = 30;
+  // Tukey 栅栏系数，0 表示不剔除
+  double outlier_factor = 1.5;
+  // 小于 0 不绑定
+  int cpu = -1;
+  // 与基线比较时，均值变化超过这个比例才算回退/提升
+  double threshold = 0.05;
+  std::string filter;
+  std::string json_path;
+  std::string baseline_path;
+};
+
+struct Result {
+  std::string name;
+  uint64_t iterations = 0;
+  // 剔除离群后的样本，每次调用的纳秒数
+  std::vector<double> samples;
+  size_t outliers = 0;
+  double mean = 0;
+  double median = 0;
+  double stddev = 0;
+  double min = 0;
+  double max = 0;
+  double ci_low = 0;
+  double ci_high = 0;
+};
+
+namespace detail {
+// 双侧 95% 的 t 分布分位数，自由度 1..30
+inline double StudentT95(size_t degrees) noexcept {
+  static constexpr double kTable[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (0 == degrees) {
+    return 0;
+  }
+  return degrees <= 30 ? kTable[degrees - 1] : 1.960;
+}
+
+// 已排序
+inline double Quantile(const std::vector<double>& sorted, double q) noexcept {
+  const double position = q * static_cast<double>(sorted.size() - 1);
+  const auto below = static_cast<size_t>(position);
+  const size_t above = std::min(below + 1, sorted.size() - 1);
+  return sorted[below] +
+         (sorted[above] - sorted[below]) * (position - static_cast<double>(below));
+}
+
+inline void Summarize(std::vector<double> samples,
+                      double outlier_factor,
+                      Result* result) {
+  std::sort(samples.begin(), samples.end());
+  if (0 < outlier_factor && 4 <= samples.size()) {
+    const double q1 = Quantile(samples, 0.25);
+    const double q3 = Quantile(samples, 0.75);
+    const double low = q1 - outlier_factor * (q3 - q1);
+    const double high = q3 + outlier_factor * (q3 - q1);
+    const size_t size = samples.size();
+    samples.erase(std::remove_if(samples.begin(), samples.end(),
+                                 [=](double x) { return x < low || x > high; }),
+                  samples.end());
+    result->outliers = size - samples.size();
+  }
+  const size_t n = samples.size();
+  double sum = 0;
+  for (const double x : samples) {
+    sum += x;
+  }
+  result->mean = sum / static_cast<double>(n);
+  double squares = 0;
+  for (const double x : samples) {
+    squares += (x - result->mean) * (x - result->mean);
+  }
+  result->stddev = 1 < n ? std::sqrt(squares / static_cast<double>(n - 1)) : 0;
+  result->median = Quantile(samples, 0.5);
+  result->min = samples.front();
+  result->max = samples.back();
+  const double margin =
+      StudentT95(n - 1) * result->stddev / std::sqrt(static_cast<double>(n));
+  result->ci_low = result->mean - margin;
+  result->ci_high = result->mean + margin;
+  result->samples = std::move(samples);
+}
+
+// 只读 WriteJson 写出的格式：每个用例一行，取 name、mean、ci_low、ci_high
+inline bool ParseNumber(std::string_view line,
+                        std::string_view key,
+                        double* value) {
+  const size_t pos = line.find(key);
+  if (std::string_view::npos == pos) {
+    return false;
+  }
+  *value = std::strtod(std::string(line.substr(pos + key.size())).c_str(),
+                       nullptr);
+  return true;
+}
+}  // namespace detail
+
+class Runner {
+ public:
+  using Batch = std::function<void(uint64_t iterations)>;
+
+  explicit Runner(Options options = {}) : options_(std::move(options)) {}
+
+  // fn 调用一次是一次操作，循环在模板里展开，没有间接调用的开销
+  template <class Function>
+  void Add(std::string name, Function fn) {
+    cases_.emplace_back(std::move(name), [fn](uint64_t iterations) mutable {
+      for (uint64_t i = 0; i < iterations; ++i) {
+        fn();
+      }
+    });
+  }
+
+  [[nodiscard]] Options& options() noexcept { return options_; }
+  [[nodiscard]] const std::vector<Result>& results() const noexcept {
+    return results_;
+  }
+
+  // 解析命令行、运行、输出、与基线比较。参数错误返回 2，有回退返回 1
+  int Main(int argc, char* argv[]) {
+    if (!ParseArguments(argc, argv)) {
+      std::fprintf(stderr,
+                   "usage: %s [--filter=substring] [--min-time=seconds] "
+                   "[--samples=n] [--cpu=n] [--json=path] [--baseline=path] "
+                   "[--threshold=ratio]\n",
+                   argv[0]);
+      return 2;
+    }
+    Run();
+    if (!options_.json_path.empty() && !WriteJson(options_.json_path)) {
+      std::fprintf(stderr, "failed to write %s\n", options_.json_path.c_str());
+      return 2;
+    }
+    if (!options_.baseline_path.empty()) {
+      std::map<std::string, Result> baseline;
+      if (!LoadBaseline(options_.baseline_path, &baseline)) {
+        std::fprintf(stderr, "failed to read %s\n",
+                     options_.baseline_path.c_str());
+        return 2;
+      }
+      return 0 < Compare(baseline) ? 1 : 0;
+    }
+    return 0;
+  }
+
+  void Run() {
+    if (0 <= options_.cpu && !PinToCpu(options_.cpu)) {
+      std::fprintf(stderr, "failed to pin to cpu %d\n", options_.cpu);
+    }
+    std::printf("%-40s %12s %12s %12s %10s %8s\n", "name", "mean ns",
+                "median ns", "+/- 95%", "iterations", "outliers");
+    for (auto& [name, batch] : cases_) {
+      if (!options_.filter.empty() &&
+          std::string::npos == name.find(options_.filter)) {
+        continue;
+      }
+      Result result = Measure(name, batch);
+      std::printf("%-40s %12.2f %12.2f %12.2f %10llu %8zu\n",
+                  result.name.c_str(), result.mean, result.median,
+                  result.ci_high - result.mean,
+                  static_cast<unsigned long long>(result.iterations),
+                  result.outliers);
+      results_.push_back(std::move(result));
+    }
+  }
+
+  bool WriteJson(const std::string& path) const {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (nullptr == file) {
+      return false;
+    }
+    std::fprintf(file, "{\"benchmarks\": [\n");
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const Result& r = results_[i];
+      std::string name;
+      for (const char c : r.name) {
+        if ('"' == c || '\\' == c) {
+          name.push_back('\\');
+        }
+        name.push_back(c);
+      }
+      std::fprintf(file,
+                   "  {\"name\": \"%s\", \"mean\": %.4f, \"median\": %.4f, "
+                   "\"stddev\": %.4f, \"min\": %.4f, \"max\": %.4f, "
+                   "\"ci_low\": %.4f, \"ci_high\": %.4f, \"samples\": %zu, "
+                   "\"outliers\": %zu, \"iterations\": %llu}%s\n",
+                   name.c_str(), r.mean, r.median, r.stddev, r.min, r.max,
+                   r.ci_low, r.ci_high, r.samples.size(), r.outliers,
+                   static_cast<unsigned long long>(r.iterations),
+                   i + 1 < results_.size() ? "," : "");
+    }
+    std::fprintf(file, "]}\n");
+    return 0 == std::fclose(file);
+  }
+
+  static bool LoadBaseline(const std::string& path,
+                           std::map<std::string, Result>* baseline) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (nullptr == file) {
+      return false;
+    }
+    std::string content;
+    char buffer[4096];
+    for (size_t size; 0 < (size = std::fread(buffer, 1, sizeof(buffer), file));) {
+      content.append(buffer, size);
+    }
+    std::fclose(file);
+
+    constexpr std::string_view kNameKey = "{\"name\": \"";
+    for (size_t begin = 0; begin < content.size();) {
+      size_t end = content.find('\n', begin);
+      if (std::string::npos == end) {
+        end = content.size();
+      }
+      const std::string_view line(content.data() + begin, end - begin);
+      begin = end + 1;
+      const size_t pos = line.find(kNameKey);
+      if (std::string_view::npos == pos) {
+        continue;
+      }
+      Result result;
+      size_t i = pos + kNameKey.size();
+      for (; i < line.size() && '"' != line[i]; ++i) {
+        if ('\\' == line[i] && i + 1 < line.size()) {
+          ++i;
+        }
+        result.name.push_back(line[i]);
+      }
+      if (detail::ParseNumber(line, "\"mean\": ", &result.mean) &&
+          detail::ParseNumber(line, "\"ci_low\": ", &result.ci_low) &&
+          detail::ParseNumber(line, "\"ci_high\": ", &result.ci_high)) {
+        (*baseline)[result.name] = std::move(result);
+      }
+    }
+    return true;
+  }
+
+  // 打印每个用例相对基线的变化，返回回退的个数
+  size_t Compare(const std::map<std::string, Result>& baseline) const {
+    size_t regressions = 0;
+    std::printf("\n%-40s %12s %12s %9s\n", "name", "baseline ns", "current ns",
+                "change");
+    for (const Result& current : results_) {
+      const auto it = baseline.find(current.name);
+      if (baseline.end() == it) {
+        continue;
+      }
+      const Result& base = it->second;
+      const double change = 0 < base.mean ? current.mean / base.mean - 1 : 0;
+      const char* verdict = "";
+      if (change > options_.threshold && current.ci_low > base.ci_high) {
+        verdict = "REGRESSION";
+        ++regressions;
+      } else if (change < -options_.threshold &&
+                 current.ci_high < base.ci_low) {
+        verdict = "improved";
+      }
+      std::printf("%-40s %12.2f %12.2f %+8.1f%% %s\n", current.name.c_str(),
+                  base.mean, current.mean, 100 * change, verdict);
+    }
+    return regressions;
+  }
+
+ private:
+  Result Measure(const std::string& name, Batch& batch) const {
+    // 预热，同时估计单次耗时
+    uint64_t iterations = 1;
+    double elapsed_ns = 0;
+    for (double warmed = 0; warmed < options_.warmup_time * 1e9;
+         warmed += elapsed_ns) {
+      elapsed_ns = Time(batch, iterations);
+      if (elapsed_ns < options_.warmup_time * 1e8) {
+        iterations *= 2;
+      }
+    }
+    const double per_iteration =
+        std::max(elapsed_ns / static_cast<double>(iterations), 0.1);
+    const int sample_count = std::max(options_.sample_count, 2);
+    const double sample_ns = options_.min_time * 1e9 / sample_count;
+    iterations = std::max<uint64_t>(
+        1, static_cast<uint64_t>(sample_ns / per_iteration));
+
+    std::vector<double> samples;
+    samples.reserve(sample_count);
+    for (int i = 0; i < sample_count; ++i) {
+      samples.push_back(Time(batch, iterations) /
+                        static_cast<double>(iterations));
+    }
+
+    Result result;
+    result.name = name;
+    result.iterations = iterations;
+    detail::Summarize(std::move(samples), options_.outlier_factor, &result);
+    return result;
+  }
+
+  static double Time(Batch& batch, uint64_t iterations) {
+    uint64_t ticks;
+    {
+      TimeMeasure measure(ticks);
+      batch(iterations);
+      ClobberMemory();
+    }
+    return static_cast<double>(TimeMeasure::ToNanoseconds(ticks));
+  }
+
+  bool ParseArguments(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+      const std::string_view arg(argv[i]);
+      const size_t equal = arg.find('=');
+      const std::string_view key = arg.substr(0, equal);
+      if (std::string_view::npos == equal) {
+        return false;
+      }
+      const std::string value(arg.substr(equal + 1));
+      if ("--filter" == key) {
+        options_.filter = value;
+      } else if ("--min-time" == key) {
+        options_.min_time = std::atof(value.c_str());
+      } else if ("--samples" == key) {
+        options_.sample_count = std::atoi(value.c_str());
+      } else if ("--cpu" == key) {
+        options_.cpu = std::atoi(value.c_str());
+      } else if ("--json" == key) {
+        options_.json_path = value;
+      } else if ("--baseline" == key) {
+        options_.baseline_path = value;
+      } else if ("--threshold" == key) {
+        options_.threshold = std::atof(value.c_str());
+      } else {
+        return false;
+      }
+    }
+    return 0 < options_.min_time && 1 < options_.sample_count;
+  }
+
+  Options options_;
+  std::vector<std::pair<std::string, Batch>> cases_;
+  std::vector<Result> results_;
+};
+}  // namespace benchmark
+}  // namespace umu
@@ -0,0 +1,971 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "time_measure.hpp"
+
+// 延迟格式化的日志：调用线程只把格式串编号、时间和参数的原始字节写进本线程的
+// 环形缓冲，不格式化、不加锁；后台线程定期取出，写成二进制文件（用
+// tools/binary_log_decode 离线转成文本），或者直接格式化成文本。
+//   umu::BinaryLogger::Instance().Open("app.ulog");
+//   UMU_BINARY_LOG("connect %s:%u took %.3f ms\n", host, port, elapsed);
+//   umu::BinaryLogger::Instance().Close();
+// 格式串是 printf 风格（char，UTF-8），必须是字面量，每个调用点只登记一次。
+// 参数支持整数、枚举、浮点、字符串（const char*、std::string、string_view，
+// 按内容拷贝）和指针。缓冲满了丢弃新记录，计入 dropped()。
+// 同一线程的记录保持顺序，不同线程的记录每批按时间排序。
+// 定义 UMU_DISABLE_BINARY_LOG 时宏展开为空
+namespace umu {
+namespace binary_log {
+enum class ArgType : uint8_t {
+  kSigned = 1,
+  kUnsigned,
+  kDouble,
+  kString,
+  kPointer,
+};
+
+// 文件格式，小端：
+//   "UMULOG01"，uint64 起始时刻（Unix 纳秒）
+//   之后是若干块，第一个字节是 Chunk：
+//   kSite：uint32 编号、uint32 行号、uint8 参数个数 + 每个参数的 ArgType、
+//          uint32 长度 + 格式串、uint32 长度 + 文件名
+//   kRecord：uint32 编号、uint32 线程、uint64 相对起始时刻的纳秒、
+//            uint32 长度 + 参数
+//   kDropped：uint64 丢弃的记录数
+// 参数：整数、浮点（double）、指针各 8 字节，字符串是 uint32 长度 + 字节
+constexpr char kMagic[] = "UMULOG01";
+
+enum class Chunk : uint8_t {
+  kSite = 1,
+  kRecord,
+  kDropped,
+};
+
+struct Site {
+  std::string_view format;
+  std::string_view file;
+  uint32_t line = 0;
+  std::vector<ArgType> types;
+};
+
+namespace detail {
+template <typename T>
+constexpr ArgType TypeOf() noexcept {
+  using U = std::decay_t<T>;
+  if constexpr (std::is_same_v<U, char*> || std::is_same_v<U, const char*> ||
+                std::is_convertible_v<const U&, std::string_view>) {
+    return ArgType::kString;
+  } else if constexpr (std::is_floating_point_v<U>) {
+    return ArgType::kDouble;
+  } else if constexpr (std::is_pointer_v<U> ||
+                       std::is_same_v<U, std::nullptr_t>) {
+    return ArgType::kPointer;
+  } else if constexpr (std::is_enum_v<U>) {
+    return TypeOf<std::underlying_type_t<U>>();
+  } else {
+    static_assert(std::is_integral_v<U>, "unsupported binary log argument");
+    return std::is_signed_v<U> ? ArgType::kSigned : ArgType::kUnsigned;
+  }
+}
+
+template <typename T>
+inline std::string_view ToText(const T& value) noexcept {
+  using U = std::decay_t<T>;
+  if constexpr (std::is_same_v<U, char*> || std::is_same_v<U, const char*>) {
+    const char* text = value;
+    return nullptr == text ? std::string_view("(null)")
+                           : std::string_view(text);
+  } else {
+    return std::string_view(value);
+  }
+}
+
+template <typename T>
+inline size_t ArgSize(const T& value) noexcept {
+  if constexpr (ArgType::kString == TypeOf<T>()) {
+    return sizeof(uint32_t) +
+           std::min<size_t>(ToText(value).size(), UINT32_MAX);
+  } else {
+    return sizeof(uint64_t);
+  }
+}
+
+// 按主机字节序写入；x86/ARM 都是小端，和文件格式一致
+template <typename T>
+inline char* Encode(char* p, const T& value) noexcept {
+  using U = std::decay_t<T>;
+  constexpr ArgType type = TypeOf<T>();
+  if constexpr (ArgType::kString == type) {
+    const std::string_view text = ToText(value);
+    const auto size =
+        static_cast<uint32_t>(std::min<size_t>(text.size(), UINT32_MAX));
+    std::memcpy(p, &size, sizeof(size));
+    std::memcpy(p + sizeof(size), text.data(), size);
+    return p + sizeof(size) + size;
+  } else {
+    uint64_t bits;
+    if constexpr (ArgType::kDouble == type) {
+      const double real = static_cast<double>(value);
+      std::memcpy(&bits, &real, sizeof(bits));
+    } else if constexpr (std::is_same_v<U, std::nullptr_t>) {
+      bits = 0;
+    } else if constexpr (ArgType::kPointer == type) {
+      bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value));
+    } else if constexpr (std::is_enum_v<U>) {
+      bits = static_cast<uint64_t>(
+          static_cast<std::underlying_type_t<U>>(value));
+    } else {
+      bits = static_cast<uint64_t>(value);
+    }
+    std::memcpy(p, &bits, sizeof(bits));
+    return p + sizeof(bits);
+  }
+}
+
+template <typename T>
+inline bool ReadPod(std::string_view* data, T* value) noexcept {
+  if (data->size() < sizeof(T)) {
+    return false;
+  }
+  uint64_t bits = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    bits |= static_cast<uint64_t>(static_cast<uint8_t>((*data)[i])) << (8 * i);
+  }
+  *value = static_cast<T>(bits);
+  data->remove_prefix(sizeof(T));
+  return true;
+}
+
+inline bool ReadText(std::string_view* data, std::string_view* text) noexcept {
+  uint32_t size;
+  if (!ReadPod(data, &size) || data->size() < size) {
+    return false;
+  }
+  *text = data->substr(0, size);
+  data->remove_prefix(size);
+  return true;
+}
+
+template <typename T>
+inline void AppendPod(std::string* data, T value) {
+  char bytes[sizeof(T)];
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    bytes[i] = static_cast<char>(static_cast<uint64_t>(value) >> (8 * i));
+  }
+  data->append(bytes, sizeof(T));
+}
+
+inline void AppendText(std::string* data, std::string_view text) {
+  AppendPod(data, static_cast<uint32_t>(text.size()));
+  data->append(text);
+}
+
+template <typename... Args>
+inline void AppendFormatted(std::string* out, const char* spec, Args... args) {
+  char buffer[256];
+  const int size = std::snprintf(buffer, sizeof(buffer), spec, args...);
+  if (size < 0) {
+    return;
+  }
+  if (static_cast<size_t>(size) < sizeof(buffer)) {
+    out->append(buffer, size);
+    return;
+  }
+  const size_t offset = out->size();
+  out->resize(offset + size + 1);
+  std::snprintf(out->data() + offset, size + 1, spec, args...);
+  out->resize(offset + size);
+}
+
+// 格式化时依次取出的参数
+class ArgReader {
+ public:
+  ArgReader(const std::vector<ArgType>& types, std::string_view payload)
+      : types_(types), payload_(payload) {}
+
+  bool Next(ArgType* type, uint64_t* bits, std::string_view* text) noexcept {
+    if (types_.size() <= index_) {
+      return false;
+    }
+    *type = types_[index_++];
+    if (ArgType::kString == *type) {
+      return ReadText(&payload_, text);
+    }
+    return ReadPod(&payload_, bits);
+  }
+
+ private:
+  const std::vector<ArgType>& types_;
+  std::string_view payload_;
+  size_t index_ = 0;
+};
+
+// spec 是 '%'、flags、宽度、精度，按参数的实际类型补上长度修饰和转换字符，
+// 转换字符和类型不符时按类型的默认方式输出，不会出现未定义行为
+inline void AppendArg(std::string* out,
+                      std::string spec,
+                      char conversion,
+                      ArgType type,
+                      uint64_t bits,
+                      std::string_view text) {
+  const auto is = [conversion](const char* set) {
+    return nullptr != std::strchr(set, conversion);
+  };
+  switch (type) {
+    case ArgType::kSigned:
+      if ('c' == conversion) {
+        AppendFormatted(out, spec.append("c").c_str(), static_cast<int>(bits));
+      } else {
+        spec.append("ll").push_back(is("ouxX") ? conversion : 'd');
+        AppendFormatted(out, spec.c_str(), static_cast<long long>(bits));
+      }
+      break;
+    case ArgType::kUnsigned:
+      if ('c' == conversion) {
+        AppendFormatted(out, spec.append("c").c_str(), static_cast<int>(bits));
+      } else {
+        spec.append("ll").push_back(is("ouxX") ? conversion : 'u');
+        AppendFormatted(out, spec.c_str(),
+                        static_cast<unsigned long long>(bits));
+      }
+      break;
+    case ArgType::kDouble: {
+      double real;
+      std::memcpy(&real, &bits, sizeof(real));
+      spec.push_back(is("fFeEgGaA") ? conversion : 'g');
+      AppendFormatted(out, spec.c_str(), real);
+      break;
+    }
+    case ArgType::kString:
+      if ('s' == conversion) {
+        const std::string copy(text);
+        AppendFormatted(out, spec.append("s").c_str(), copy.c_str());
+      } else {
+        out->append(text);
+      }
+      break;
+    case ArgType::kPointer:
+      AppendFormatted(out, "0x%llx", static_cast<unsigned long long>(bits));
+      break;
+  }
+}
+}  // namespace detail
+
+// 按登记的格式串和参数类型格式化一条记录，追加到 out。
+// 参数不够时余下的转换说明原样输出
+inline void FormatMessage(const Site& site,
+                          std::string_view payload,
+                          std::string* out) {
+  const std::string_view format = site.format;
+  detail::ArgReader reader(site.types, payload);
+  ArgType type;
+  uint64_t bits = 0;
+  std::string_view text;
+  for (size_t i = 0; i < format.size();) {
+    const size_t percent = format.find('%', i);
+    out->append(format.substr(i, percent - i));
+    if (std::string_view::npos == percent) {
+      break;
+    }
+    if (percent + 1 < format.size() && '%' == format[percent + 1]) {
+      out->push_back('%');
+      i = percent + 2;
+      continue;
+    }
+    std::string spec("%");
+    bool complete = true;
+    size_t j = percent + 1;
+    while (j < format.size() && nullptr != std::strchr("-+ #0", format[j])) {
+      spec.push_back(format[j++]);
+    }
+    // 宽度和精度，'*' 从参数中取
+    for (int part = 0; part < 2 && complete; ++part) {
+      if (1 == part) {
+        if (format.size() <= j || '.' != format[j]) {
+          break;
+        }
+        spec.push_back(format[j++]);
+      }
+      if (j < format.size() && '*' == format[j]) {
+        ++j;
+        if (reader.Next(&type, &bits, &text) && ArgType::kString != type &&
+            ArgType::kDouble != type) {
+          spec.append(std::to_string(static_cast<int>(bits)));
+        } else {
+          complete = false;
+        }
+      }
+      while (j < format.size() && '0' <= format[j] && format[j] <= '9') {
+        spec.push_back(format[j++]);
+      }
+    }
+    // 长度修饰按参数类型重新生成，包括 MSVC 的 I64/I32
+    while (j < format.size() &&
+           nullptr != std::strchr("hlLqjzt", format[j])) {
+      ++j;
+    }
+    if (j < format.size() && 'I' == format[j]) {
+      ++j;
+      while (j < format.size() && '0' <= format[j] && format[j] <= '9') {
+        ++j;
+      }
+    }
+    if (format.size() <= j) {
+      out->append(format.substr(percent));
+      break;
+    }
+    const char conversion = format[j++];
+    if ('n' == conversion) {
+      reader.Next(&type, &bits, &text);
+    } else if (complete && reader.Next(&type, &bits, &text)) {
+      detail::AppendArg(out, std::move(spec), conversion, type, bits, text);
+    } else {
+      out->append(format.substr(percent, j - percent));
+    }
+    i = j;
+  }
+}
+
+// "2026-10-17 08:30:00.123456"（UTC）
+inline void AppendTimestamp(uint64_t unix_ns, std::string* out) {
+  const uint64_t seconds = unix_ns / 1000000000;
+  // 公历日期，days 从 1970-01-01 起
+  const int64_t days = static_cast<int64_t>(seconds / 86400) + 719468;
+  const int64_t era = days / 146097;
+  const auto day_of_era = static_cast<uint32_t>(days - era * 146097);
+  const uint32_t year_of_era =
+      (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+       day_of_era / 146096) / 365;
+  const uint32_t day_of_year =
+      day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const uint32_t mp = (5 * day_of_year + 2) / 153;
+  const uint32_t day = day_of_year - (153 * mp + 2) / 5 + 1;
+  const uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+  const int64_t year = static_cast<int64_t>(year_of_era) + era * 400 +
+                       (month <= 2 ? 1 : 0);
+  const auto second_of_day = static_cast<uint32_t>(seconds % 86400);
+  detail::AppendFormatted(
+      out, "%04lld-%02u-%02u %02u:%02u:%02u.%06u",
+      static_cast<long long>(year), month, day, second_of_day / 3600,
+      second_of_day / 60 % 60, second_of_day % 60,
+      static_cast<uint32_t>(unix_ns % 1000000000 / 1000));
+}
+
+// 一行文本：时间 [线程] 消息，消息末尾的换行去掉后统一加一个
+inline void AppendLine(uint64_t unix_ns,
+                       uint32_t thread,
+                       const Site& site,
+                       std::string_view payload,
+                       std::string* out) {
+  AppendTimestamp(unix_ns, out);
+  detail::AppendFormatted(out, " [%u] ", thread);
+  FormatMessage(site, payload, out);
+  while (!out->empty() && ('\n' == out->back() || '\r' == out->back())) {
+    out->pop_back();
+  }
+  out->push_back('\n');
+}
+
+// 二进制日志转文本，可以分块喂入，块的边界不必和记录对齐：
+//   binary_log::Decoder decoder;
+//   while (ReadChunk(&chunk)) { decoder.Feed(chunk, &text); Write(text); }
+//   if (!decoder.Finish()) { /* 文件不完整或者格式错误 */ }
+class Decoder {
+ public:
+  // 解析出的行追加到 text，格式错误时返回 false，之后的数据都会被忽略
+  bool Feed(std::string_view chunk, std::string* text) {
+    if (failed_) {
+      return false;
+    }
+    std::string_view data = chunk;
+    if (!pending_.empty()) {
+      pending_.append(chunk);
+      data = pending_;
+    }
+    size_t consumed = 0;
+    for (;;) {
+      std::string_view rest = data.substr(consumed);
+      const Status status = DecodeOne(&rest, text);
+      if (Status::kIncomplete == status) {
+        break;
+      }
+      if (Status::kError == status) {
+        failed_ = true;
+        return false;
+      }
+      consumed = data.size() - rest.size();
+    }
+    if (pending_.empty()) {
+      pending_.assign(data.substr(consumed));
+    } else {
+      pending_.erase(0, consumed);
+    }
+    return true;
+  }
+
+  // 数据结束后调用，还有不完整的块时返回 false
+  [[nodiscard]] bool Finish() const noexcept {
+    return !failed_ && header_read_ && pending_.empty();
+  }
+
+  // kDropped 块累计的丢弃记录数
+  [[nodiscard]] uint64_t dropped() const noexcept { return dropped_; }
+
+ private:
+  enum class Status { kOk, kIncomplete, kError };
+
+  // 成功时 data 前移到下一块
+  Status DecodeOne(std::string_view* data, std::string* text) {
+    std::string_view p = *data;
+    if (!header_read_) {
+      constexpr size_t magic_size = sizeof(kMagic) - 1;
+      if (p.size() < magic_size + sizeof(uint64_t)) {
+        return Status::kIncomplete;
+      }
+      if (p.substr(0, magic_size) != std::string_view(kMagic, magic_size)) {
+        return Status::kError;
+      }
+      p.remove_prefix(magic_size);
+      detail::ReadPod(&p, &epoch_unix_ns_);
+      header_read_ = true;
+      *data = p;
+      return Status::kOk;
+    }
+    uint8_t chunk;
+    if (!detail::ReadPod(&p, &chunk)) {
+      return Status::kIncomplete;
+    }
+    switch (static_cast<Chunk>(chunk)) {
+      case Chunk::kSite: {
+        uint32_t id;
+        uint32_t line;
+        uint8_t count;
+        if (!detail::ReadPod(&p, &id) || !detail::ReadPod(&p, &line) ||
+            !detail::ReadPod(&p, &count) || p.size() < count) {
+          return Status::kIncomplete;
+        }
+        SiteText site;
+        site.site.line = line;
+        for (uint8_t i = 0; i < count; ++i) {
+          const auto type = static_cast<ArgType>(p[i]);
+          if (type < ArgType::kSigned || ArgType::kPointer < type) {
+            return Status::kError;
+          }
+          site.site.types.push_back(type);
+        }
+        p.remove_prefix(count);
+        std::string_view format;
+        std::string_view file;
+        if (!detail::ReadText(&p, &format) || !detail::ReadText(&p, &file)) {
+          return Status::kIncomplete;
+        }
+        // 编号由写入端依次分配，跳号说明数据损坏
+        if (0 == id || sites_.size() + 1 < id) {
+          return Status::kError;
+        }
+        site.format.assign(format);
+        site.file.assign(file);
+        if (sites_.size() < id) {
+          sites_.emplace_back();
+        }
+        sites_[id - 1] = std::move(site);
+        sites_[id - 1].Bind();
+        break;
+      }
+      case Chunk::kRecord: {
+        uint32_t id;
+        uint32_t thread;
+        uint64_t time_ns;
+        std::string_view payload;
+        if (!detail::ReadPod(&p, &id) || !detail::ReadPod(&p, &thread) ||
+            !detail::ReadPod(&p, &time_ns) ||
+            !detail::ReadText(&p, &payload)) {
+          return Status::kIncomplete;
+        }
+        if (0 == id || sites_.size() < id) {
+          return Status::kError;
+        }
+        AppendLine(epoch_unix_ns_ + time_ns, thread, sites_[id - 1].site,
+                   payload, text);
+        break;
+      }
+      case Chunk::kDropped: {
+        uint64_t count;
+        if (!detail::ReadPod(&p, &count)) {
+          return Status::kIncomplete;
+        }
+        dropped_ += count;
+        break;
+      }
+      default:
+        return Status::kError;
+    }
+    *data = p;
+    return Status::kOk;
+  }
+
+  // 自己保存格式串和文件名，Site 中的 view 指向它们
+  struct SiteText {
+    std::string format;
+    std::string file;
+    Site site;
+
+    void Bind() noexcept {
+      site.format = format;
+      site.file = file;
+    }
+  };
+
+  // deque 扩展时元素不移动，view 一直有效
+  std::deque<SiteText> sites_;
+  std::string pending_;
+  uint64_t epoch_unix_ns_ = 0;
+  uint64_t dropped_ = 0;
+  bool header_read_ = false;
+  bool failed_ = false;
+};
+}  // namespace binary_log
+
+class BinaryLogger {
+ public:
+#if UMU_HAS_TSC
+  using Clock = TscClock<false>;
+#else
+  using Clock = SystemClock;
+#endif
+  // 每个线程的缓冲字节数，2 的幂
+  static constexpr size_t kThreadCapacity = 1 << 20;
+  // 后台线程取数据的间隔
+  static constexpr auto kFlushInterval = std::chrono::milliseconds(10);
+
+  enum class OutputFormat : uint8_t {
+    kBinary,  // 二进制，用 binary_log::Decoder 转文本
+    kText,    // 后台线程格式化
+  };
+
+  static BinaryLogger& Instance() {
+    static BinaryLogger logger;
+    return logger;
+  }
+
+  ~BinaryLogger() { Close(); }
+
+  // 打开输出文件并启动后台线程，已经打开时先关闭
+  bool Open(const char* path, OutputFormat format = OutputFormat::kBinary) {
+    std::FILE* file = std::fopen(path, "wb");
+    if (nullptr == file) {
+      return false;
+    }
+    Start(file, format, true);
+    return true;
+  }
+
+  // 写入调用者的 file（例如 stderr），Close 时不关闭
+  void Open(std::FILE* file, OutputFormat format) {
+    Start(file, format, false);
+  }
+
+  // 取完所有已记录的内容，停止后台线程，关闭文件
+  void Close() {
+    std::unique_lock<std::mutex> lock(writer_mutex_);
+    if (!writer_.joinable()) {
+      return;
+    }
+    stop_ = true;
+    wake_.notify_one();
+    lock.unlock();
+    writer_.join();
+    lock.lock();
+    stop_ = false;
+    std::fflush(file_);
+    if (owns_file_) {
+      std::fclose(file_);
+    }
+    file_ = nullptr;
+  }
+
+  // 等待调用前记录的内容都写出
+  void Flush() {
+    std::unique_lock<std::mutex> lock(writer_mutex_);
+    if (!writer_.joinable()) {
+      return;
+    }
+    const uint64_t target = ++flush_requested_;
+    wake_.notify_one();
+    flushed_.wait(lock, [this, target] { return target <= flush_done_; });
+  }
+
+  void SetEnabled(bool enabled) noexcept {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] bool enabled() const noexcept {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // 缓冲满而丢弃的记录数（还没被后台线程统计的不算）
+  [[nodiscard]] uint64_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // 由 UMU_BINARY_LOG 调用，site 是调用点的静态变量
+  template <size_t N, typename... Args>
+  void Log(std::atomic<uint32_t>* site,
+           const char* file,
+           uint32_t line,
+           const char (&format)[N],
+           const Args&... args) {
+    static_assert(sizeof...(Args) <= UINT8_MAX, "too many arguments");
+    if (!enabled()) {
+      return;
+    }
+    uint32_t id = site->load(std::memory_order_acquire);
+    if (0 == id) {
+      static constexpr std::array<binary_log::ArgType, sizeof...(Args)>
+          kTypes = {binary_log::detail::TypeOf<Args>()...};
+      id = Register(site, file, line, std::string_view(format, N - 1),
+                    kTypes.data(), kTypes.size());
+    }
+    const size_t payload_size =
+        (size_t{0} + ... + binary_log::detail::ArgSize(args));
+    const size_t size =
+        (sizeof(RecordHeader) + payload_size + kRecordAlign - 1) &
+        ~(kRecordAlign - 1);
+    ThreadBuffer* buffer = CurrentThread().buffer.get();
+    char* p = buffer->Reserve(size);
+    if (nullptr == p) {
+      buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    const RecordHeader header{static_cast<uint32_t>(size), id,
+                              static_cast<uint32_t>(payload_size), 0,
+                              Clock::Start()};
+    std::memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    ((p = binary_log::detail::Encode(p, args)), ...);
+    if (buffer->Commit(size)) {
+      RequestDrain();
+    }
+  }
+
+ private:
+  // 记录按 32 字节对齐，缓冲末尾剩下的空间是 32 的倍数，总能放下一个填充头
+  static constexpr size_t kRecordAlign = 32;
+
+  struct RecordHeader {
+    uint32_t size;  // 包括头和对齐，site 为 0 时是缓冲末尾的填充
+    uint32_t site;
+    uint32_t payload_size;
+    uint32_t reserved;
+    uint64_t time;
+  };
+  static_assert(0 == sizeof(RecordHeader) % 8);
+  static_assert(sizeof(RecordHeader) <= kRecordAlign);
+  static_assert(0 == kThreadCapacity % kRecordAlign);
+
+  // 单生产者（所属线程）单消费者（后台线程）的字节环
+  struct ThreadBuffer {
+    explicit ThreadBuffer(uint32_t thread_id)
+        : data(new char[kThreadCapacity]), thread(thread_id) {}
+
+    // 返回连续 size 字节的写入位置，空间不够时返回 nullptr
+    char* Reserve(size_t size) noexcept {
+      const uint64_t write = head.load(std::memory_order_relaxed);
+      const uint64_t read = tail.load(std::memory_order_acquire);
+      const size_t offset = write & (kThreadCapacity - 1);
+      const size_t padding =
+          kThreadCapacity - offset < size ? kThreadCapacity - offset : 0;
+      if (kThreadCapacity - (write - read) < padding + size) {
+        return nullptr;
+      }
+      if (0 != padding) {
+        const RecordHeader filler{static_cast<uint32_t>(padding), 0, 0, 0, 0};
+        std::memcpy(data.get() + offset, &filler, sizeof(filler));
+      }
+      reserved = write + padding;
+      crossed_half = write - read < kThreadCapacity / 2 &&
+                     kThreadCapacity / 2 <= reserved + size - read;
+      return data.get() + (reserved & (kThreadCapacity - 1));
+    }
+
+    // 返回 true 表示这次写入使缓冲超过一半，应该提前唤醒后台线程
+    bool Commit(size_t size) noexcept {
+      head.store(reserved + size, std::memory_order_release);
+      return crossed_half;
+    }
+
+    std::unique_ptr<char[]> data;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    uint64_t reserved = 0;
+    bool crossed_half = false;
+    uint32_t thread;
+    std::atomic<bool> exited{false};
+  };
+
+  // 线程退出时标记缓冲，后台线程取完后释放
+  struct ThreadState {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadState() {
+      if (buffer) {
+        buffer->exited.store(true, std::memory_order_release);
+      }
+    }
+  };
+
+  struct PendingRecord {
+    uint64_t time;
+    const ThreadBuffer* buffer;
+    const char* record;
+  };
+
+  BinaryLogger()
+      : epoch_(Clock::Start()),
+        epoch_unix_ns_(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count())) {}
+
+  ThreadState& CurrentThread() {
+    static thread_local ThreadState state;
+    if (!state.buffer) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      state.buffer = std::make_shared<ThreadBuffer>(next_thread_++);
+      buffers_.push_back(state.buffer);
+    }
+    return state;
+  }
+
+  uint32_t Register(std::atomic<uint32_t>* site,
+                    const char* file,
+                    uint32_t line,
+                    std::string_view format,
+                    const binary_log::ArgType* types,
+                    size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t id = site->load(std::memory_order_relaxed);
+    if (0 == id) {
+      sites_.push_back({format, file, line, {types, types + count}});
+      id = static_cast<uint32_t>(sites_.size());
+      site->store(id, std::memory_order_release);
+    }
+    return id;
+  }
+
+  void Start(std::FILE* file, OutputFormat format, bool owns_file) {
+    Close();
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    file_ = file;
+    owns_file_ = owns_file;
+    format_ = format;
+    written_sites_ = 0;
+    text_sites_.clear();
+    if (OutputFormat::kBinary == format_) {
+      std::string header(binary_log::kMagic, sizeof(binary_log::kMagic) - 1);
+      binary_log::detail::AppendPod(&header, epoch_unix_ns_);
+      std::fwrite(header.data(), 1, header.size(), file_);
+    }
+    writer_ = std::thread(&BinaryLogger::Run, this);
+  }
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(writer_mutex_);
+    for (;;) {
+      const bool stop = stop_;
+      const uint64_t requested = flush_requested_;
+      drain_requested_ = false;
+      lock.unlock();
+      Drain();
+      lock.lock();
+      flush_done_ = requested;
+      flushed_.notify_all();
+      if (stop) {
+        return;
+      }
+      wake_.wait_for(lock, kFlushInterval, [this, requested] {
+        return stop_ || drain_requested_ || requested != flush_requested_;
+      });
+    }
+  }
+
+  // 取出所有线程已提交的记录，按时间排序后写出
+  void Drain() {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::vector<uint64_t> heads;
+    std::vector<bool> exited;
+    uint64_t dropped = 0;
+    {
+      // 读 head 之后登记的调用点一定已经在 sites_ 里
+      std::lock_guard<std::mutex> lock(mutex_);
+      buffers = buffers_;
+      for (const auto& buffer : buffers) {
+        exited.push_back(buffer->exited.load(std::memory_order_acquire));
+        heads.push_back(buffer->head.load(std::memory_order_acquire));
+        dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+      }
+      for (; written_sites_ < sites_.size(); ++written_sites_) {
+        if (OutputFormat::kBinary == format_) {
+          AppendSite(written_sites_ + 1, sites_[written_sites_]);
+        } else {
+          text_sites_.push_back(sites_[written_sites_]);
+        }
+      }
+    }
+
+    records_.clear();
+    for (size_t i = 0; i < buffers.size(); ++i) {
+      const ThreadBuffer& buffer = *buffers[i];
+      for (uint64_t position = buffer.tail.load(std::memory_order_relaxed);
+           position < heads[i];) {
+        const char* record =
+            buffer.data.get() + (position & (kThreadCapacity - 1));
+        RecordHeader header;
+        std::memcpy(&header, record, sizeof(header));
+        if (0 != header.site) {
+          records_.push_back({header.time, &buffer, record});
+        }
+        position += header.size;
+      }
+    }
+    std::stable_sort(records_.begin(), records_.end(),
+                     [](const PendingRecord& a, const PendingRecord& b) {
+                       return a.time < b.time;
+                     });
+    for (const PendingRecord& pending : records_) {
+      RecordHeader header;
+      std::memcpy(&header, pending.record, sizeof(header));
+      const std::string_view payload(pending.record + sizeof(header),
+                                     header.payload_size);
+      const uint64_t time_ns =
+          header.time < epoch_ ? 0 : Clock::ToNanoseconds(header.time - epoch_);
+      if (OutputFormat::kBinary == format_) {
+        output_.push_back(static_cast<char>(binary_log::Chunk::kRecord));
+        binary_log::detail::AppendPod(&output_, header.site);
+        binary_log::detail::AppendPod(&output_, pending.buffer->thread);
+        binary_log::detail::AppendPod(&output_, time_ns);
+        binary_log::detail::AppendText(&output_, payload);
+      } else {
+        binary_log::AppendLine(epoch_unix_ns_ + time_ns,
+                               pending.buffer->thread,
+                               text_sites_[header.site - 1], payload,
+                               &output_);
+      }
+      if (kThreadCapacity <= output_.size()) {
+        WriteOutput();
+      }
+    }
+    if (0 != dropped) {
+      dropped_.fetch_add(dropped, std::memory_order_relaxed);
+      if (OutputFormat::kBinary == format_) {
+        output_.push_back(static_cast<char>(binary_log::Chunk::kDropped));
+        binary_log::detail::AppendPod(&output_, dropped);
+      } else {
+        binary_log::detail::AppendFormatted(
+            &output_, "[binary log] %llu records dropped\n",
+            static_cast<unsigned long long>(dropped));
+      }
+    }
+    WriteOutput();
+    std::fflush(file_);
+
+    for (size_t i = 0; i < buffers.size(); ++i) {
+      buffers[i]->tail.store(heads[i], std::memory_order_release);
+    }
+    // 已退出且取完的线程
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < buffers.size(); ++i) {
+      if (exited[i]) {
+        buffers_.erase(std::find(buffers_.begin(), buffers_.end(), buffers[i]));
+      }
+    }
+  }
+
+  // 调用线程的缓冲过半时唤醒后台线程，不等下一个周期
+  void RequestDrain() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    drain_requested_ = true;
+    wake_.notify_one();
+  }
+
+  void AppendSite(size_t id, const binary_log::Site& site) {
+    output_.push_back(static_cast<char>(binary_log::Chunk::kSite));
+    binary_log::detail::AppendPod(&output_, static_cast<uint32_t>(id));
+    binary_log::detail::AppendPod(&output_, site.line);
+    binary_log::detail::AppendPod(&output_,
+                                  static_cast<uint8_t>(site.types.size()));
+    for (const binary_log::ArgType type : site.types) {
+      output_.push_back(static_cast<char>(type));
+    }
+    binary_log::detail::AppendText(&output_, site.format);
+    binary_log::detail::AppendText(&output_, site.file);
+  }
+
+  void WriteOutput() {
+    std::fwrite(output_.data(), 1, output_.size(), file_);
+    output_.clear();
+  }
+
+  std::atomic<bool> enabled_{true};
+  std::atomic<uint64_t> dropped_{0};
+  const uint64_t epoch_;
+  const uint64_t epoch_unix_ns_;
+
+  // 保护 buffers_、sites_
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+  std::vector<binary_log::Site> sites_;
+  uint32_t next_thread_ = 1;
+
+  // 保护后台线程的状态
+  std::mutex writer_mutex_;
+  std::condition_variable wake_;
+  std::condition_variable flushed_;
+  std::thread writer_;
+  bool stop_ = false;
+  bool drain_requested_ = false;
+  uint64_t flush_requested_ = 0;
+  uint64_t flush_done_ = 0;
+
+  // 以下只由后台线程使用
+  std::FILE* file_ = nullptr;
+  bool owns_file_ = false;
+  OutputFormat format_ = OutputFormat::kBinary;
+  size_t written_sites_ = 0;
+  std::vector<binary_log::Site> text_sites_;
+  std::vector<PendingRecord> records_;
+  std::string output_;
+
+  // noncopyable
+  BinaryLogger(const BinaryLogger&) = delete;
+  BinaryLogger& operator=(const BinaryLogger&) = delete;
+};
+}  // namespace umu
+
+#if defined(UMU_DISABLE_BINARY_LOG)
+#define UMU_BINARY_LOG(...) static_cast<void>(0)
+#else
+#define UMU_BINARY_LOG(...)                                             \
+  do {                                                                  \
+    static std::atomic<uint32_t> umu_binary_log_site{0};                \
+    ::umu::BinaryLogger::Instance().Log(&umu_binary_log_site, __FILE__, \
+                                        __LINE__, __VA_ARGS__);         \
+  } while (false)
+#endif
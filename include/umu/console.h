@@ -1,12 +1,18 @@
-#pragma once
+﻿#pragma once
+
+#include <memory>
 
 #if _HAS_CXX17
 #include <string_view>
 #endif
 
 #include <conio.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <tchar.h>
 
+// 同步写入，每次调用都有几次系统调用；输出量大时用 async_console.hpp 的 AsyncWriter，
+// 需要常开的日志用 binary_log.hpp
 namespace umu {
 namespace console {
 #if _HAS_CXX17
@@ -74,18 +80,40 @@ inline int ColorError(WORD color, LPCTSTR buffer) {
 }
 #endif
 
+// 先格式化再写入 console_output，一般长度的输出不分配内存
 inline int ColorWritef(HANDLE console_output, WORD color, LPCTSTR format, ...) {
-  HANDLE std_out = ::GetStdHandle(STD_OUTPUT_HANDLE);
-  CONSOLE_SCREEN_BUFFER_INFO csbi;
-  if (!GetConsoleScreenBufferInfo(std_out, &csbi)) {
+  TCHAR stack_buffer[1024];
+  std::unique_ptr<TCHAR[]> heap_buffer;
+  TCHAR* buffer = stack_buffer;
+  va_list args;
+  va_start(args, format);
+  int length = _vsctprintf(format, args);
+  va_end(args);
+  if (length < 0) {
     return -1;
   }
-
-  ::SetConsoleTextAttribute(std_out, color);
-  va_list args;
+  if (_countof(stack_buffer) <= static_cast<size_t>(length)) {
+    heap_buffer.reset(new TCHAR[length + 1]);
+    buffer = heap_buffer.get();
+  }
   va_start(args, format);
-  int count = _vtcprintf_s(format, args);
-  ::SetConsoleTextAttribute(std_out, csbi.wAttributes);
+  length = _vstprintf_s(buffer, length + 1, format, args);
+  va_end(args);
+  if (length < 0) {
+    return -1;
+  }
+
+  CONSOLE_SCREEN_BUFFER_INFO csbi;
+  if (!GetConsoleScreenBufferInfo(console_output, &csbi)) {
+    return -1;
+  }
+  ::SetConsoleTextAttribute(console_output, color);
+  DWORD count;
+  if (!WriteConsole(console_output, buffer, static_cast<DWORD>(length), &count,
+                    nullptr)) {
+    count = 0;
+  }
+  ::SetConsoleTextAttribute(console_output, csbi.wAttributes);
   return count;
 }
 
@@ -0,0 +1,660 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "simd.h"
+
+// UTF-8/UTF-16/UTF-32 互转。输入先校验，非法输入（截断、过长编码、
+// 代理项、超出 0x10FFFF、落单的代理项）返回 kInvalid。
+// UTF-16 可以用 char16_t 或 Windows 的 wchar_t，UTF-32 可以用 char32_t
+// 或 Linux 的 wchar_t，按 sizeof 区分。
+// 写入调用者缓冲的函数不检查容量，所需的最大长度：
+//   UTF-8  -> UTF-16/UTF-32: size
+//   UTF-16 -> UTF-8: 3 * size
+//   UTF-32 -> UTF-8: 4 * size
+//   UTF-16 <-> UTF-32: size
+namespace umu {
+namespace encoding {
+inline constexpr size_t kInvalid = static_cast<size_t>(-1);
+
+namespace detail {
+// 不校验，调用者保证 p 处是合法的 UTF-8
+inline char32_t DecodeUtf8(const uint8_t* p, size_t* length) noexcept {
+  const uint8_t c = p[0];
+  if (c < 0x80) {
+    *length = 1;
+    return c;
+  }
+  if (c < 0xE0) {
+    *length = 2;
+    return ((c & 0x1F) << 6) | (p[1] & 0x3F);
+  }
+  if (c < 0xF0) {
+    *length = 3;
+    return ((c & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+  }
+  *length = 4;
+  return ((c & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) |
+         (p[3] & 0x3F);
+}
+
+inline size_t EncodeUtf8(char32_t code_point, char* out) noexcept {
+  if (code_point < 0x80) {
+    out[0] = static_cast<char>(code_point);
+    return 1;
+  }
+  if (code_point < 0x800) {
+    out[0] = static_cast<char>(0xC0 | (code_point >> 6));
+    out[1] = static_cast<char>(0x80 | (code_point & 0x3F));
+    return 2;
+  }
+  if (code_point < 0x10000) {
+    out[0] = static_cast<char>(0xE0 | (code_point >> 12));
+    out[1] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (code_point & 0x3F));
+    return 3;
+  }
+  out[0] = static_cast<char>(0xF0 | (code_point >> 18));
+  out[1] = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+  out[2] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+  out[3] = static_cast<char>(0x80 | (code_point & 0x3F));
+  return 4;
+}
+
+template <typename Utf16Char>
+inline size_t EncodeUtf16(char32_t code_point, Utf16Char* out) noexcept {
+  if (code_point < 0x10000) {
+    out[0] = static_cast<Utf16Char>(code_point);
+    return 1;
+  }
+  code_point -= 0x10000;
+  out[0] = static_cast<Utf16Char>(0xD800 | (code_point >> 10));
+  out[1] = static_cast<Utf16Char>(0xDC00 | (code_point & 0x3FF));
+  return 2;
+}
+
+inline bool IsValidCodePoint(char32_t code_point) noexcept {
+  return code_point < 0xD800 || (code_point > 0xDFFF && code_point <= 0x10FFFF);
+}
+
+// 按首字节返回序列长度和第二个字节的范围（RFC 3629），非法首字节返回 0
+inline size_t Utf8SequenceLength(uint8_t c, uint8_t* low, uint8_t* high) noexcept {
+  *low = 0x80;
+  *high = 0xBF;
+  if (c < 0x80) {
+    return 1;
+  }
+  if (c >= 0xC2 && c <= 0xDF) {
+    return 2;
+  }
+  if (c >= 0xE0 && c <= 0xEF) {
+    if (0xE0 == c) {
+      *low = 0xA0;
+    } else if (0xED == c) {
+      *high = 0x9F;
+    }
+    return 3;
+  }
+  if (c >= 0xF0 && c <= 0xF4) {
+    if (0xF0 == c) {
+      *low = 0x90;
+    } else if (0xF4 == c) {
+      *high = 0x8F;
+    }
+    return 4;
+  }
+  return 0;
+}
+
+// p 处是否是完整合法的 UTF-8 序列，是则返回长度，否则返回 0
+inline size_t CheckUtf8Sequence(const uint8_t* p, size_t size) noexcept {
+  uint8_t low;
+  uint8_t high;
+  const size_t length = Utf8SequenceLength(p[0], &low, &high);
+  if (0 == length || size < length) {
+    return 0;
+  }
+  if (1 < length && (p[1] < low || p[1] > high)) {
+    return 0;
+  }
+  for (size_t i = 2; i < length; ++i) {
+    if ((p[i] & 0xC0) != 0x80) {
+      return 0;
+    }
+  }
+  return length;
+}
+
+inline bool ValidateUtf8Scalar(const uint8_t* p, size_t size) noexcept {
+  const uint8_t* const last = p + size;
+  while (p < last) {
+#if UMU_SIMD_X86
+    while (last - p >= 16 &&
+           0 == _mm_movemask_epi8(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))) {
+      p += 16;
+    }
+    if (p == last) {
+      break;
+    }
+#endif
+    if (*p < 0x80) {
+      ++p;
+      continue;
+    }
+    const size_t length = CheckUtf8Sequence(p, last - p);
+    if (0 == length) {
+      return false;
+    }
+    p += length;
+  }
+  return true;
+}
+
+#if UMU_SIMD_X86
+// Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"：
+// 用前一字节的高/低半字节和当前字节的高半字节各查一次表，三者相与即为错误位
+class Utf8Checker {
+ public:
+  static constexpr uint8_t kTooShort = 1 << 0;
+  static constexpr uint8_t kTooLong = 1 << 1;
+  static constexpr uint8_t kOverlong3 = 1 << 2;
+  static constexpr uint8_t kTooLarge = 1 << 3;
+  static constexpr uint8_t kSurrogate = 1 << 4;
+  static constexpr uint8_t kOverlong2 = 1 << 5;
+  static constexpr uint8_t kTooLarge1000 = 1 << 6;
+  static constexpr uint8_t kOverlong4 = 1 << 6;
+  static constexpr uint8_t kTwoContinuations = 1 << 7;
+  static constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoContinuations;
+
+  UMU_TARGET_AVX2 static __m256i Table(const uint8_t (&table)[16]) noexcept {
+    return _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(table)));
+  }
+
+  // 前 n 个字节来自上一块
+  template <int N>
+  UMU_TARGET_AVX2 static __m256i Previous(__m256i input,
+                                          __m256i previous) noexcept {
+    return _mm256_alignr_epi8(
+        input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+  }
+
+  UMU_TARGET_AVX2 static bool Validate(const uint8_t* p, size_t size) noexcept {
+    static constexpr uint8_t kByte1High[16] = {
+        kTooLong,          kTooLong,
+        kTooLong,          kTooLong,
+        kTooLong,          kTooLong,
+        kTooLong,          kTooLong,
+        kTwoContinuations, kTwoContinuations,
+        kTwoContinuations, kTwoContinuations,
+        kTooShort | kOverlong2,
+        kTooShort,
+        kTooShort | kOverlong3 | kSurrogate,
+        kTooShort | kTooLarge | kTooLarge1000 | kOverlong4};
+    static constexpr uint8_t kByte1Low[16] = {
+        kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+        kCarry | kOverlong2,
+        kCarry,
+        kCarry,
+        kCarry | kTooLarge,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000};
+    static constexpr uint8_t kByte2High[16] = {
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooLong | kOverlong2 | kTwoContinuations | kOverlong3 |
+            kTooLarge1000 | kOverlong4,
+        kTooLong | kOverlong2 | kTwoContinuations | kOverlong3 | kTooLarge,
+        kTooLong | kOverlong2 | kTwoContinuations | kSurrogate | kTooLarge,
+        kTooLong | kOverlong2 | kTwoContinuations | kSurrogate | kTooLarge,
+        kTooShort,
+        kTooShort,
+        kTooShort,
+        kTooShort};
+    // 最后 3 个字节如果是多字节序列的开头，说明序列在块尾被截断
+    static constexpr uint8_t kIncompleteMax[32] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF};
+
+    Utf8Checker checker;
+    checker.byte_1_high_table_ = Table(kByte1High);
+    checker.byte_1_low_table_ = Table(kByte1Low);
+    checker.byte_2_high_table_ = Table(kByte2High);
+    checker.incomplete_max_ = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(kIncompleteMax));
+    checker.error_ = _mm256_setzero_si256();
+    checker.previous_ = _mm256_setzero_si256();
+    checker.previous_incomplete_ = _mm256_setzero_si256();
+
+    const uint8_t* const last = p + size;
+    for (; last - p >= 32; p += 32) {
+      checker.Check(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+    if (p < last) {
+      // 用 0 补齐，0 是 ASCII，不会掩盖错误
+      uint8_t block[32] = {};
+      for (size_t i = 0; p + i < last; ++i) {
+        block[i] = p[i];
+      }
+      checker.Check(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)));
+    }
+    const __m256i error =
+        _mm256_or_si256(checker.error_, checker.previous_incomplete_);
+    return _mm256_testz_si256(error, error);
+  }
+
+ private:
+  UMU_TARGET_AVX2 void Check(__m256i input) noexcept {
+    if (0 == _mm256_movemask_epi8(input)) {
+      error_ = _mm256_or_si256(error_, previous_incomplete_);
+      previous_ = input;
+      return;
+    }
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+    const __m256i previous1 = Previous<1>(input, previous_);
+    const __m256i byte_1_high = _mm256_shuffle_epi8(
+        byte_1_high_table_,
+        _mm256_and_si256(_mm256_srli_epi16(previous1, 4), nibble_mask));
+    const __m256i byte_1_low = _mm256_shuffle_epi8(
+        byte_1_low_table_, _mm256_and_si256(previous1, nibble_mask));
+    const __m256i byte_2_high = _mm256_shuffle_epi8(
+        byte_2_high_table_,
+        _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble_mask));
+    const __m256i special = _mm256_and_si256(
+        _mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+    // 3/4 字节序列的第 3/4 个字节必须是 continuation
+    const __m256i third = _mm256_subs_epu8(Previous<2>(input, previous_),
+                                           _mm256_set1_epi8(0x60));
+    const __m256i fourth = _mm256_subs_epu8(Previous<3>(input, previous_),
+                                            _mm256_set1_epi8(0x70));
+    const __m256i must_be_continuation =
+        _mm256_and_si256(_mm256_or_si256(third, fourth),
+                         _mm256_set1_epi8(static_cast<char>(0x80)));
+    error_ =
+        _mm256_or_si256(error_, _mm256_xor_si256(must_be_continuation, special));
+    previous_incomplete_ = _mm256_subs_epu8(input, incomplete_max_);
+    previous_ = input;
+  }
+
+  __m256i byte_1_high_table_;
+  __m256i byte_1_low_table_;
+  __m256i byte_2_high_table_;
+  __m256i incomplete_max_;
+  __m256i error_;
+  __m256i previous_;
+  __m256i previous_incomplete_;
+};
+#endif
+
+template <typename WideChar, size_t Size = sizeof(WideChar)>
+struct WideCodec;
+
+template <typename WideChar>
+struct WideCodec<WideChar, 2> {
+  static size_t FromUtf8(std::string_view in, WideChar* out) noexcept;
+  static size_t ToUtf8(const WideChar* in, size_t size, char* out) noexcept;
+};
+
+template <typename WideChar>
+struct WideCodec<WideChar, 4> {
+  static size_t FromUtf8(std::string_view in, WideChar* out) noexcept;
+  static size_t ToUtf8(const WideChar* in, size_t size, char* out) noexcept;
+};
+}  // namespace detail
+
+[[nodiscard]] inline bool ValidateUtf8(std::string_view s) noexcept {
+  const auto* p = reinterpret_cast<const uint8_t*>(s.data());
+#if UMU_SIMD_X86
+  if (s.size() >= 64 && simd::HasAvx2()) {
+    return detail::Utf8Checker::Validate(p, s.size());
+  }
+#endif
+  return detail::ValidateUtf8Scalar(p, s.size());
+}
+
+// 合法 UTF-8 转成 UTF-16 的长度，不校验
+[[nodiscard]] inline size_t Utf16LengthFromUtf8(std::string_view s) noexcept {
+  size_t length = 0;
+  for (const char c : s) {
+    const auto b = static_cast<uint8_t>(c);
+    // 非 continuation 字节各算一个，4 字节序列再多一个代理项
+    length += ((b & 0xC0) != 0x80) + (b >= 0xF0);
+  }
+  return length;
+}
+
+// 合法 UTF-8 转成 UTF-32 的长度，不校验
+[[nodiscard]] inline size_t Utf32LengthFromUtf8(std::string_view s) noexcept {
+  size_t length = 0;
+  for (const char c : s) {
+    length += (static_cast<uint8_t>(c) & 0xC0) != 0x80;
+  }
+  return length;
+}
+
+inline constexpr char32_t kInvalidCodePoint = 0xFFFFFFFF;
+
+// 读取一个字符并前进。UTF-8/UTF-16/UTF-32 按 sizeof(CharType) 区分，
+// 遇到非法单元只前进一个单元并返回 kInvalidCodePoint
+template <typename CharType>
+inline char32_t NextCodePoint(const CharType*& p,
+                              const CharType* last) noexcept {
+  if constexpr (1 == sizeof(CharType)) {
+    const auto* u = reinterpret_cast<const uint8_t*>(p);
+    const size_t length = detail::CheckUtf8Sequence(u, last - p);
+    if (0 == length) {
+      ++p;
+      return kInvalidCodePoint;
+    }
+    size_t decoded;
+    const char32_t code_point = detail::DecodeUtf8(u, &decoded);
+    p += length;
+    return code_point;
+  } else if constexpr (2 == sizeof(CharType)) {
+    const char32_t unit = static_cast<uint16_t>(*p++);
+    if (unit < 0xD800 || unit > 0xDFFF) {
+      return unit;
+    }
+    if (unit > 0xDBFF || p == last) {
+      return kInvalidCodePoint;
+    }
+    const char32_t low = static_cast<uint16_t>(*p);
+    if (low < 0xDC00 || low > 0xDFFF) {
+      return kInvalidCodePoint;
+    }
+    ++p;
+    return 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+  } else {
+    const auto code_point = static_cast<char32_t>(*p++);
+    return detail::IsValidCodePoint(code_point) ? code_point
+                                                : kInvalidCodePoint;
+  }
+}
+
+#pragma region "UTF-8 <-> UTF-16"
+template <typename Utf16Char>
+inline size_t Utf8ToUtf16(std::string_view in, Utf16Char* out) noexcept {
+  static_assert(2 == sizeof(Utf16Char));
+  if (!ValidateUtf8(in)) {
+    return kInvalid;
+  }
+  const auto* p = reinterpret_cast<const uint8_t*>(in.data());
+  const uint8_t* const last = p + in.size();
+  Utf16Char* const first = out;
+  while (p < last) {
+#if UMU_SIMD_X86
+    for (; last - p >= 16; p += 16, out += 16) {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      if (0 != _mm_movemask_epi8(v)) {
+        break;
+      }
+      const __m128i zero = _mm_setzero_si128();
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                       _mm_unpacklo_epi8(v, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8),
+                       _mm_unpackhi_epi8(v, zero));
+    }
+    if (p == last) {
+      break;
+    }
+#endif
+    size_t length;
+    out += detail::EncodeUtf16(detail::DecodeUtf8(p, &length), out);
+    p += length;
+  }
+  return out - first;
+}
+
+template <typename Utf16Char>
+inline size_t Utf16ToUtf8(const Utf16Char* in,
+                          size_t size,
+                          char* out) noexcept {
+  static_assert(2 == sizeof(Utf16Char));
+  const Utf16Char* const last = in + size;
+  char* const first = out;
+  while (in < last) {
+#if UMU_SIMD_X86
+    const __m128i non_ascii = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i zero = _mm_setzero_si128();
+    for (; last - in >= 16; in += 16, out += 16) {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+      const __m128i b =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 8));
+      const __m128i high = _mm_or_si128(_mm_and_si128(a, non_ascii),
+                                        _mm_and_si128(b, non_ascii));
+      if (0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi16(high, zero))) {
+        break;
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                       _mm_packus_epi16(a, b));
+    }
+    if (in == last) {
+      break;
+    }
+#endif
+    char32_t code_point = static_cast<uint16_t>(*in++);
+    if (code_point >= 0xD800 && code_point <= 0xDFFF) {
+      if (code_point > 0xDBFF || in == last) {
+        return kInvalid;
+      }
+      const char32_t low = static_cast<uint16_t>(*in);
+      if (low < 0xDC00 || low > 0xDFFF) {
+        return kInvalid;
+      }
+      ++in;
+      code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+    }
+    out += detail::EncodeUtf8(code_point, out);
+  }
+  return out - first;
+}
+#pragma endregion
+
+#pragma region "UTF-8 <-> UTF-32"
+template <typename Utf32Char>
+inline size_t Utf8ToUtf32(std::string_view in, Utf32Char* out) noexcept {
+  static_assert(4 == sizeof(Utf32Char));
+  if (!ValidateUtf8(in)) {
+    return kInvalid;
+  }
+  const auto* p = reinterpret_cast<const uint8_t*>(in.data());
+  const uint8_t* const last = p + in.size();
+  Utf32Char* const first = out;
+  while (p < last) {
+#if UMU_SIMD_X86
+    for (; last - p >= 16; p += 16, out += 16) {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      if (0 != _mm_movemask_epi8(v)) {
+        break;
+      }
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i low = _mm_unpacklo_epi8(v, zero);
+      const __m128i high = _mm_unpackhi_epi8(v, zero);
+      auto* o = reinterpret_cast<__m128i*>(out);
+      _mm_storeu_si128(o, _mm_unpacklo_epi16(low, zero));
+      _mm_storeu_si128(o + 1, _mm_unpackhi_epi16(low, zero));
+      _mm_storeu_si128(o + 2, _mm_unpacklo_epi16(high, zero));
+      _mm_storeu_si128(o + 3, _mm_unpackhi_epi16(high, zero));
+    }
+    if (p == last) {
+      break;
+    }
+#endif
+    size_t length;
+    *out++ = static_cast<Utf32Char>(detail::DecodeUtf8(p, &length));
+    p += length;
+  }
+  return out - first;
+}
+
+template <typename Utf32Char>
+inline size_t Utf32ToUtf8(const Utf32Char* in,
+                          size_t size,
+                          char* out) noexcept {
+  static_assert(4 == sizeof(Utf32Char));
+  const Utf32Char* const last = in + size;
+  char* const first = out;
+  while (in < last) {
+#if UMU_SIMD_X86
+    const __m128i non_ascii = _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+    const __m128i zero = _mm_setzero_si128();
+    for (; last - in >= 16; in += 16, out += 16) {
+      const auto* v = reinterpret_cast<const __m128i*>(in);
+      const __m128i a = _mm_loadu_si128(v);
+      const __m128i b = _mm_loadu_si128(v + 1);
+      const __m128i c = _mm_loadu_si128(v + 2);
+      const __m128i d = _mm_loadu_si128(v + 3);
+      const __m128i high = _mm_and_si128(
+          _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), non_ascii);
+      if (0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi32(high, zero))) {
+        break;
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                       _mm_packus_epi16(_mm_packs_epi32(a, b),
+                                        _mm_packs_epi32(c, d)));
+    }
+    if (in == last) {
+      break;
+    }
+#endif
+    const auto code_point = static_cast<char32_t>(*in++);
+    if (!detail::IsValidCodePoint(code_point)) {
+      return kInvalid;
+    }
+    out += detail::EncodeUtf8(code_point, out);
+  }
+  return out - first;
+}
+#pragma endregion
+
+#pragma region "UTF-16 <-> UTF-32"
+template <typename Utf16Char, typename Utf32Char>
+inline size_t Utf16ToUtf32(const Utf16Char* in,
+                           size_t size,
+                           Utf32Char* out) noexcept {
+  static_assert(2 == sizeof(Utf16Char) && 4 == sizeof(Utf32Char));
+  const Utf16Char* const last = in + size;
+  Utf32Char* const first = out;
+  while (in < last) {
+    char32_t code_point = static_cast<uint16_t>(*in++);
+    if (code_point >= 0xD800 && code_point <= 0xDFFF) {
+      if (code_point > 0xDBFF || in == last) {
+        return kInvalid;
+      }
+      const char32_t low = static_cast<uint16_t>(*in);
+      if (low < 0xDC00 || low > 0xDFFF) {
+        return kInvalid;
+      }
+      ++in;
+      code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+    }
+    *out++ = static_cast<Utf32Char>(code_point);
+  }
+  return out - first;
+}
+
+template <typename Utf32Char, typename Utf16Char>
+inline size_t Utf32ToUtf16(const Utf32Char* in,
+                           size_t size,
+                           Utf16Char* out) noexcept {
+  static_assert(4 == sizeof(Utf32Char) && 2 == sizeof(Utf16Char));
+  const Utf32Char* const last = in + size;
+  Utf16Char* const first = out;
+  while (in < last) {
+    const auto code_point = static_cast<char32_t>(*in++);
+    if (!detail::IsValidCodePoint(code_point)) {
+      return kInvalid;
+    }
+    out += detail::EncodeUtf16(code_point, out);
+  }
+  return out - first;
+}
+#pragma endregion
+
+#pragma region "String"
+namespace detail {
+template <typename WideChar>
+size_t WideCodec<WideChar, 2>::FromUtf8(std::string_view in,
+                                        WideChar* out) noexcept {
+  return Utf8ToUtf16(in, out);
+}
+
+template <typename WideChar>
+size_t WideCodec<WideChar, 2>::ToUtf8(const WideChar* in,
+                                      size_t size,
+                                      char* out) noexcept {
+  return Utf16ToUtf8(in, size, out);
+}
+
+template <typename WideChar>
+size_t WideCodec<WideChar, 4>::FromUtf8(std::string_view in,
+                                        WideChar* out) noexcept {
+  return Utf8ToUtf32(in, out);
+}
+
+template <typename WideChar>
+size_t WideCodec<WideChar, 4>::ToUtf8(const WideChar* in,
+                                      size_t size,
+                                      char* out) noexcept {
+  return Utf32ToUtf8(in, size, out);
+}
+}  // namespace detail
+
+// UTF-8 转成 wstring/u16string/u32string，按字符宽度选 UTF-16 或 UTF-32。
+// out 一次分配到最大长度，失败时 out 被清空
+template <class WideString>
+inline bool Utf8ToWide(std::string_view in, WideString* out) {
+  using WideChar = typename WideString::value_type;
+  out->resize(in.size());
+  const size_t length = detail::WideCodec<WideChar>::FromUtf8(in, out->data());
+  if (kInvalid == length) {
+    out->clear();
+    return false;
+  }
+  out->resize(length);
+  return true;
+}
+
+template <typename WideChar>
+inline bool WideToUtf8(std::basic_string_view<WideChar> in, std::string* out) {
+  out->resize((2 == sizeof(WideChar) ? 3 : 4) * in.size());
+  const size_t length =
+      detail::WideCodec<WideChar>::ToUtf8(in.data(), in.size(), out->data());
+  if (kInvalid == length) {
+    out->clear();
+    return false;
+  }
+  out->resize(length);
+  return true;
+}
+
+template <class WideString>
+inline bool WideToUtf8(const WideString& in, std::string* out) {
+  using WideChar = typename WideString::value_type;
+  return WideToUtf8(std::basic_string_view<WideChar>(in.data(), in.size()),
+                    out);
+}
+#pragma endregion
+}  // namespace encoding
+}  // namespace umu
@@ -1,77 +1,131 @@
-#pragma once
+﻿#pragma once
 
 #include <string>
 
+#include "inplace_string.hpp"
+
 namespace umu {
 namespace env {
 inline bool GetEnvironmentVariableA(_In_opt_ const std::string& name,
                                     _Out_opt_ std::string* value) {
-  DWORD length = ::GetEnvironmentVariableA(name.data(), nullptr, 0);
-  // if length == 1, it's ""
-  if (length > 0) {
-    // length including terminating null character
-    if (nullptr != value) {
-      value->resize(length - 1);
-      length = ::GetEnvironmentVariableA(name.data(), value->data(), length);
-      if (length == 0) {
-        return false;
-      }
+  if (nullptr == value) {
+    // if length == 1, it's ""
+    return 0 < ::GetEnvironmentVariableA(name.data(), nullptr, 0);
+  }
+  // 大多数变量都不长，先用栈上的缓冲区，一次调用就能取到
+  char buffer[256];
+  ::SetLastError(ERROR_SUCCESS);
+  DWORD length =
+      ::GetEnvironmentVariableA(name.data(), buffer, _countof(buffer));
+  if (0 == length) {
+    // 变量存在但为空时 GetLastError 不是 ERROR_ENVVAR_NOT_FOUND
+    if (ERROR_ENVVAR_NOT_FOUND == ::GetLastError()) {
+      return false;
     }
+    value->clear();
     return true;
   }
-  // GetLastError returns ERROR_ENVVAR_NOT_FOUND
-  return false;
+  if (length < _countof(buffer)) {
+    value->assign(buffer, length);
+    return true;
+  }
+  // length including terminating null character
+  for (;;) {
+    value->resize(length - 1);
+    const DWORD size = length;
+    length = ::GetEnvironmentVariableA(name.data(), value->data(), size);
+    if (0 == length) {
+      return false;
+    }
+    if (length < size) {
+      value->resize(length);
+      return true;
+    }
+  }
 }
 inline bool GetEnvironmentVariableW(_In_opt_ const std::wstring& name,
                                     _Out_opt_ std::wstring* value) {
-  DWORD length = ::GetEnvironmentVariableW(name.data(), nullptr, 0);
-  // if length == 1, it's ""
-  if (length > 0) {
-    // length including terminating null character
-    if (nullptr != value) {
-      value->resize(length - 1);
-      length = ::GetEnvironmentVariableW(name.data(), value->data(), length);
-      if (length == 0) {
-        return false;
-      }
+  if (nullptr == value) {
+    // if length == 1, it's ""
+    return 0 < ::GetEnvironmentVariableW(name.data(), nullptr, 0);
+  }
+  // 大多数变量都不长，先用栈上的缓冲区，一次调用就能取到
+  wchar_t buffer[256];
+  ::SetLastError(ERROR_SUCCESS);
+  DWORD length =
+      ::GetEnvironmentVariableW(name.data(), buffer, _countof(buffer));
+  if (0 == length) {
+    // 变量存在但为空时 GetLastError 不是 ERROR_ENVVAR_NOT_FOUND
+    if (ERROR_ENVVAR_NOT_FOUND == ::GetLastError()) {
+      return false;
     }
+    value->clear();
+    return true;
+  }
+  if (length < _countof(buffer)) {
+    value->assign(buffer, length);
     return true;
   }
-  // GetLastError returns ERROR_ENVVAR_NOT_FOUND
-  return false;
+  // length including terminating null character
+  for (;;) {
+    value->resize(length - 1);
+    const DWORD size = length;
+    length = ::GetEnvironmentVariableW(name.data(), value->data(), size);
+    if (0 == length) {
+      return false;
+    }
+    if (length < size) {
+      value->resize(length);
+      return true;
+    }
+  }
 }
 
 inline std::string ExpandEnvironmentStringA(const std::string& original) {
-  if (std::string::npos != original.find('%')) {
-    // max = 32 * 1024
-    const DWORD c_size = 32 * 1024;
-    std::string expanded;
-    expanded.resize(c_size);
-    int length = (int)ExpandEnvironmentStringsA(original.data(),
-                                                expanded.data(), c_size);
-    if (0 != length) {
+  if (std::string::npos == original.find('%')) {
+    return original;
+  }
+  // 先按原长加 MAX_PATH 试一次，不够时按返回的长度重试，
+  // 不再固定分配 32K
+  std::string expanded;
+  DWORD size = static_cast<DWORD>(original.size()) + MAX_PATH;
+  for (;;) {
+    expanded.resize(size);
+    // length including terminating null character
+    const DWORD length = ::ExpandEnvironmentStringsA(
+        original.data(), expanded.data(), size);
+    if (0 == length) {
+      return original;
+    }
+    if (length <= size) {
       expanded.resize(length - 1);
       return expanded;
     }
+    size = length;
   }
-
-  return original;
 }
 inline std::wstring ExpandEnvironmentStringW(const std::wstring& original) {
-  if (std::wstring::npos != original.find(L'%')) {
-    // max = 32 * 1024
-    const DWORD c_size = 32 * 1024;
-    std::wstring expanded;
-    expanded.resize(c_size);
-    int length = (int)ExpandEnvironmentStringsW(original.data(),
-                                                expanded.data(), c_size);
-    if (0 != length) {
+  if (std::wstring::npos == original.find(L'%')) {
+    return original;
+  }
+  // 先按原长加 MAX_PATH 试一次，不够时按返回的长度重试，
+  // 不再固定分配 32K
+  std::wstring expanded;
+  DWORD size = static_cast<DWORD>(original.size()) + MAX_PATH;
+  for (;;) {
+    expanded.resize(size);
+    // length including terminating null character
+    const DWORD length = ::ExpandEnvironmentStringsW(
+        original.data(), expanded.data(), size);
+    if (0 == length) {
+      return original;
+    }
+    if (length <= size) {
       expanded.resize(length - 1);
       return expanded;
     }
+    size = length;
   }
-
-  return original;
 }
 
 // no \ tail, unless it's root
@@ -142,5 +196,47 @@ inline std::wstring GetTempDirectoryW() {
     buffer_size = size;
   }
 }
+
+// 写入 inplace_basic_string，路径在容量以内时不分配内存。
+// error 策略下放不下时返回 false，temp_dir 为空且 overflow() 为 true
+template <typename CharType, size_t N, class Policy>
+inline bool GetTempDirectory(
+    inplace_basic_string<CharType, N, Policy>* temp_dir) {
+  temp_dir->clear();
+  for (;;) {
+    temp_dir->resize_for_overwrite(temp_dir->capacity());
+    const auto buffer_size = static_cast<DWORD>(temp_dir->capacity() + 1);
+    DWORD size;
+    if constexpr (1 == sizeof(CharType)) {
+      size = ::GetTempPathA(buffer_size, temp_dir->data());
+    } else {
+      size = ::GetTempPathW(buffer_size, temp_dir->data());
+    }
+    if (0 == size) {
+      ATLTRACE2(atlTraceException, 0, __FUNCTION__ ": #%d\n", ::GetLastError());
+      temp_dir->resize(0);
+      return false;
+    }
+    if (size < buffer_size) {
+      temp_dir->resize(size);
+      return true;
+    }
+    // size 是需要的长度，包括 '\0'
+    if (!temp_dir->reserve(size)) {
+      temp_dir->resize(0);
+      return false;
+    }
+  }
+}
+
+template <size_t N, class Policy>
+inline bool GetTempDirectoryA(inplace_basic_string<char, N, Policy>* temp_dir) {
+  return GetTempDirectory(temp_dir);
+}
+template <size_t N, class Policy>
+inline bool GetTempDirectoryW(
+    inplace_basic_string<wchar_t, N, Policy>* temp_dir) {
+  return GetTempDirectory(temp_dir);
+}
 }  // end of namespace env
 }  // end of namespace umu
\ No newline at end of file
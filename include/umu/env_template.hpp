@@ -0,0 +1,368 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include "encoding.h"
+
+extern char** environ;
+#endif
+
+// 环境变量展开：模板先编译成字面量/变量片段，再对环境快照展开，
+// 先算出精确长度，一次分配。
+//   static const auto snapshot = umu::env::EnvironmentSnapshot<char>::Capture();
+//   const umu::env::EnvTemplate<char> path("${HOME}/.config/%APP%");
+//   std::string expanded = path.Expand(snapshot);
+// %VAR%：和 ExpandEnvironmentStrings 一致，变量不存在时原样保留；
+// ${VAR}：和 shell 一致，变量不存在时展开为空。
+// Windows 上变量名不区分大小写（按 ASCII 比较）
+namespace umu {
+namespace env {
+namespace detail {
+#if defined(_WIN32)
+constexpr bool kCaseInsensitiveNames = true;
+#else
+constexpr bool kCaseInsensitiveNames = false;
+#endif
+
+template <typename CharType>
+constexpr CharType FoldNameChar(CharType c) noexcept {
+  if constexpr (kCaseInsensitiveNames) {
+    return ('a' <= c && c <= 'z') ? static_cast<CharType>(c - 0x20) : c;
+  } else {
+    return c;
+  }
+}
+
+template <typename CharType>
+inline uint32_t HashName(std::basic_string_view<CharType> name) noexcept {
+  // FNV-1a
+  uint32_t hash = 2166136261U;
+  for (const CharType c : name) {
+    hash = (hash ^ static_cast<uint32_t>(FoldNameChar(c))) * 16777619U;
+  }
+  return hash;
+}
+
+template <typename CharType>
+inline bool NameEquals(std::basic_string_view<CharType> a,
+                       std::basic_string_view<CharType> b) noexcept {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (FoldNameChar(a[i]) != FoldNameChar(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace detail
+
+// 某一时刻环境变量的副本：所有 name=value 连续存放在一个字符串里，
+// 开放寻址哈希表按名字查找，查找不分配内存。
+// Refresh 与 Find 不能并发
+template <typename CharType>
+class EnvironmentSnapshot {
+ public:
+  using view_type = std::basic_string_view<CharType>;
+
+  EnvironmentSnapshot() = default;
+
+  [[nodiscard]] static EnvironmentSnapshot Capture() {
+    EnvironmentSnapshot snapshot;
+    snapshot.Refresh();
+    return snapshot;
+  }
+
+  // 重新读取当前进程的环境变量
+  void Refresh() {
+    block_.clear();
+    entries_.clear();
+#if defined(_WIN32)
+    if constexpr (1 == sizeof(CharType)) {
+      LPCH strings = GetEnvironmentStringsA();
+      if (nullptr != strings) {
+        LoadBlock(reinterpret_cast<const CharType*>(strings));
+        FreeEnvironmentStringsA(strings);
+      }
+    } else {
+      LPWCH strings = GetEnvironmentStringsW();
+      if (nullptr != strings) {
+        LoadBlock(reinterpret_cast<const CharType*>(strings));
+        FreeEnvironmentStringsW(strings);
+      }
+    }
+#else
+    for (char** p = environ; nullptr != p && nullptr != *p; ++p) {
+      if constexpr (1 == sizeof(CharType)) {
+        Append(std::basic_string_view<CharType>(
+            reinterpret_cast<const CharType*>(*p)));
+      } else {
+        std::basic_string<CharType> wide;
+        if (encoding::Utf8ToWide(std::string_view(*p), &wide)) {
+          Append(wide);
+        }
+      }
+    }
+#endif
+    Rehash();
+  }
+
+  // 直接设置，测试或者覆盖部分变量时用。调用后需要 Rehash
+  void Set(view_type name, view_type value) {
+    std::basic_string<CharType> entry(name);
+    entry.push_back('=');
+    entry.append(value);
+    Append(entry);
+  }
+
+  void Rehash() {
+    size_t capacity = 16;
+    while (capacity < entries_.size() * 2) {
+      capacity *= 2;
+    }
+    index_.assign(capacity, kEmpty);
+    const size_t mask = capacity - 1;
+    for (uint32_t i = 0; i < entries_.size(); ++i) {
+      const view_type name = Name(entries_[i]);
+      size_t slot = detail::HashName(name) & mask;
+      while (kEmpty != index_[slot]) {
+        // 后出现的同名变量覆盖先出现的
+        if (detail::NameEquals(Name(entries_[index_[slot]]), name)) {
+          break;
+        }
+        slot = (slot + 1) & mask;
+      }
+      index_[slot] = i;
+    }
+  }
+
+  // 找到时返回 true，value 指向快照内部
+  bool Find(view_type name, view_type* value) const noexcept {
+    if (index_.empty()) {
+      return false;
+    }
+    const size_t mask = index_.size() - 1;
+    for (size_t slot = detail::HashName(name) & mask; kEmpty != index_[slot];
+         slot = (slot + 1) & mask) {
+      const Entry& entry = entries_[index_[slot]];
+      if (detail::NameEquals(Name(entry), name)) {
+        if (nullptr != value) {
+          *value = Value(entry);
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  [[nodiscard]] size_t size() const noexcept { return entries_.size(); }
+
+ private:
+  struct Entry {
+    uint32_t offset;
+    uint32_t name_size;
+    uint32_t value_size;
+  };
+
+  static constexpr uint32_t kEmpty = UINT32_MAX;
+
+  view_type Name(const Entry& entry) const noexcept {
+    return view_type(block_.data() + entry.offset, entry.name_size);
+  }
+
+  view_type Value(const Entry& entry) const noexcept {
+    return view_type(block_.data() + entry.offset + entry.name_size + 1,
+                     entry.value_size);
+  }
+
+#if defined(_WIN32)
+  // name=value\0name=value\0\0
+  void LoadBlock(const CharType* p) {
+    while (0 != *p) {
+      const view_type entry(p);
+      Append(entry);
+      p += entry.size() + 1;
+    }
+  }
+#endif
+
+  // Windows 的 "=C:=C:\dir" 这类隐藏变量名字以 '=' 开头，从第二个字符找 '='
+  void Append(view_type entry) {
+    const size_t equal = entry.find('=', 1);
+    if (view_type::npos == equal) {
+      return;
+    }
+    entries_.push_back({static_cast<uint32_t>(block_.size()),
+                        static_cast<uint32_t>(equal),
+                        static_cast<uint32_t>(entry.size() - equal - 1)});
+    block_.append(entry);
+  }
+
+  std::basic_string<CharType> block_;
+  std::vector<Entry> entries_;
+  std::vector<uint32_t> index_;
+};
+
+// 编译好的展开模板，可以对不同快照重复展开，线程安全
+template <typename CharType>
+class EnvTemplate {
+ public:
+  using view_type = std::basic_string_view<CharType>;
+  using string_type = std::basic_string<CharType>;
+
+  static constexpr uint32_t kPercentSyntax = 1;  // %VAR%
+  static constexpr uint32_t kBraceSyntax = 2;    // ${VAR}
+
+  EnvTemplate() = default;
+
+  explicit EnvTemplate(view_type pattern,
+                       uint32_t syntax = kPercentSyntax | kBraceSyntax) {
+    Compile(pattern, syntax);
+  }
+
+  void Compile(view_type pattern,
+               uint32_t syntax = kPercentSyntax | kBraceSyntax) {
+    pattern_.assign(pattern);
+    segments_.clear();
+    literal_size_ = 0;
+    size_t literal_start = 0;
+    for (size_t i = 0; i < pattern_.size();) {
+      size_t name_start;
+      size_t name_end;
+      size_t next;
+      Kind kind;
+      const CharType c = pattern_[i];
+      if ('%' == c && 0 != (syntax & kPercentSyntax)) {
+        name_start = i + 1;
+        name_end = pattern_.find('%', name_start);
+        next = name_end + 1;
+        kind = Kind::kPercent;
+      } else if ('$' == c && 0 != (syntax & kBraceSyntax) &&
+                 i + 1 < pattern_.size() && '{' == pattern_[i + 1]) {
+        name_start = i + 2;
+        name_end = pattern_.find('}', name_start);
+        next = name_end + 1;
+        kind = Kind::kBrace;
+      } else {
+        ++i;
+        continue;
+      }
+      // 没有闭合或者名字为空时按字面量处理
+      if (string_type::npos == name_end || name_start == name_end) {
+        i = string_type::npos == name_end ? pattern_.size() : name_end;
+        continue;
+      }
+      AddLiteral(literal_start, i);
+      segments_.push_back({kind, name_start, name_end - name_start,
+                           i, next - i});
+      i = next;
+      literal_start = next;
+    }
+    AddLiteral(literal_start, pattern_.size());
+  }
+
+  // 模板中没有变量，展开结果就是模板本身
+  [[nodiscard]] bool IsLiteral() const noexcept {
+    for (const Segment& segment : segments_) {
+      if (Kind::kLiteral != segment.kind) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // 展开后的精确长度
+  [[nodiscard]] size_t ExpandedSize(
+      const EnvironmentSnapshot<CharType>& snapshot) const noexcept {
+    size_t size = literal_size_;
+    for (const Segment& segment : segments_) {
+      if (Kind::kLiteral != segment.kind) {
+        size += Resolve(snapshot, segment).size();
+      }
+    }
+    return size;
+  }
+
+  // 结果写入 result（覆盖原内容），返回长度
+  size_t Expand(const EnvironmentSnapshot<CharType>& snapshot,
+                string_type* result) const {
+    const size_t size = ExpandedSize(snapshot);
+    result->resize(size);
+    CharType* p = result->data();
+    for (const Segment& segment : segments_) {
+      const view_type part = Kind::kLiteral == segment.kind
+                                 ? Text(segment.offset, segment.size)
+                                 : Resolve(snapshot, segment);
+      p = std::copy(part.begin(), part.end(), p);
+    }
+    return size;
+  }
+
+  [[nodiscard]] string_type Expand(
+      const EnvironmentSnapshot<CharType>& snapshot) const {
+    string_type result;
+    Expand(snapshot, &result);
+    return result;
+  }
+
+  [[nodiscard]] view_type pattern() const noexcept { return pattern_; }
+
+ private:
+  enum class Kind : uint8_t { kLiteral, kPercent, kBrace };
+
+  struct Segment {
+    Kind kind;
+    // 字面量的范围，或者变量名的范围
+    size_t offset;
+    size_t size;
+    // 变量在模板中的完整写法，%VAR% 找不到时原样输出
+    size_t source_offset;
+    size_t source_size;
+  };
+
+  view_type Text(size_t offset, size_t size) const noexcept {
+    return view_type(pattern_.data() + offset, size);
+  }
+
+  view_type Resolve(const EnvironmentSnapshot<CharType>& snapshot,
+                    const Segment& segment) const noexcept {
+    view_type value;
+    if (snapshot.Find(Text(segment.offset, segment.size), &value)) {
+      return value;
+    }
+    return Kind::kPercent == segment.kind
+               ? Text(segment.source_offset, segment.source_size)
+               : view_type();
+  }
+
+  void AddLiteral(size_t first, size_t last) {
+    if (first < last) {
+      segments_.push_back({Kind::kLiteral, first, last - first, first,
+                           last - first});
+      literal_size_ += last - first;
+    }
+  }
+
+  string_type pattern_;
+  std::vector<Segment> segments_;
+  size_t literal_size_ = 0;
+};
+
+// 一次性展开，模板需要重复使用时应该保留 EnvTemplate
+template <typename CharType>
+[[nodiscard]] inline std::basic_string<CharType> Expand(
+    std::basic_string_view<CharType> pattern,
+    const EnvironmentSnapshot<CharType>& snapshot) {
+  return EnvTemplate<CharType>(pattern).Expand(snapshot);
+}
+}  // end of namespace env
+}  // end of namespace umu
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace umu {
+// 编译期定长字符串，size() 恒为 N，末尾带 '\0'。
+// 成员是公开的，C++20 下可以直接作为模板实参
+template <typename CharType, size_t N>
+struct fixed_string {
+  using value_type = CharType;
+  using size_type = size_t;
+  using const_iterator = const CharType*;
+  using view_type = std::basic_string_view<CharType>;
+
+  constexpr fixed_string() noexcept = default;
+
+  constexpr fixed_string(const CharType (&s)[N + 1]) noexcept {
+    for (size_t i = 0; i < N; ++i) {
+      chars[i] = s[i];
+    }
+  }
+
+  [[nodiscard]] static constexpr size_type size() noexcept { return N; }
+  [[nodiscard]] static constexpr bool empty() noexcept { return 0 == N; }
+
+  [[nodiscard]] constexpr const CharType* data() const noexcept {
+    return chars;
+  }
+  [[nodiscard]] constexpr CharType* data() noexcept { return chars; }
+  [[nodiscard]] constexpr const CharType* c_str() const noexcept {
+    return chars;
+  }
+
+  [[nodiscard]] constexpr const_iterator begin() const noexcept {
+    return chars;
+  }
+  [[nodiscard]] constexpr const_iterator end() const noexcept {
+    return chars + N;
+  }
+
+  [[nodiscard]] constexpr CharType operator[](size_t i) const noexcept {
+    return chars[i];
+  }
+  [[nodiscard]] constexpr CharType& operator[](size_t i) noexcept {
+    return chars[i];
+  }
+
+  [[nodiscard]] constexpr view_type view() const noexcept {
+    return {chars, N};
+  }
+  constexpr operator view_type() const noexcept { return {chars, N}; }
+
+  [[nodiscard]] std::basic_string<CharType> str() const {
+    return {chars, N};
+  }
+
+  template <size_t M>
+  [[nodiscard]] constexpr fixed_string<CharType, N + M> operator+(
+      const fixed_string<CharType, M>& other) const noexcept {
+    fixed_string<CharType, N + M> result;
+    for (size_t i = 0; i < N; ++i) {
+      result.chars[i] = chars[i];
+    }
+    for (size_t i = 0; i < M; ++i) {
+      result.chars[N + i] = other.chars[i];
+    }
+    return result;
+  }
+
+  CharType chars[N + 1]{};
+};
+
+template <typename CharType, size_t M>
+fixed_string(const CharType (&)[M]) -> fixed_string<CharType, M - 1>;
+
+template <typename CharType, size_t N, size_t M>
+[[nodiscard]] constexpr bool operator==(
+    const fixed_string<CharType, N>& lhs,
+    const fixed_string<CharType, M>& rhs) noexcept {
+  return lhs.view() == rhs.view();
+}
+
+template <typename CharType, size_t N>
+[[nodiscard]] constexpr bool operator==(
+    const fixed_string<CharType, N>& lhs,
+    std::basic_string_view<CharType> rhs) noexcept {
+  return lhs.view() == rhs;
+}
+}  // namespace umu
@@ -0,0 +1,298 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "simd.h"
+#include "time_measure.hpp"
+
+// 高动态范围（HDR）直方图：对数分段、段内线性，内存固定，Record 为 O(1)。
+// significant_digits 位有效数字，例如 2 表示相对误差不超过 1%。
+// 超过 max_value 的值计入最后一个桶，Max() 仍然精确
+namespace umu {
+namespace detail {
+// 2^(sub_bucket_bits - 1) 个线性子桶覆盖一个 2 的幂区间
+class HistogramLayout {
+ public:
+  HistogramLayout(uint64_t max_value, int significant_digits) noexcept {
+    significant_digits = std::clamp(significant_digits, 1, 5);
+    uint64_t resolution = 2;
+    for (int i = 0; i < significant_digits; ++i) {
+      resolution *= 10;
+    }
+    sub_bucket_bits_ = 1;
+    while ((uint64_t{1} << sub_bucket_bits_) < resolution) {
+      ++sub_bucket_bits_;
+    }
+    max_value_ = std::max<uint64_t>(max_value, 1);
+    size_ = Index(max_value_) + 1;
+  }
+
+  [[nodiscard]] size_t size() const noexcept { return size_; }
+  [[nodiscard]] uint64_t max_value() const noexcept { return max_value_; }
+
+  [[nodiscard]] size_t Index(uint64_t value) const noexcept {
+    const uint64_t full = uint64_t{1} << sub_bucket_bits_;
+    if (value < full) {
+      return static_cast<size_t>(value);
+    }
+    const uint32_t shift = HighestBit(value) - sub_bucket_bits_ + 1;
+    return static_cast<size_t>((uint64_t{shift} << (sub_bucket_bits_ - 1)) +
+                               (value >> shift));
+  }
+
+  // 计入 index 的最大值
+  [[nodiscard]] uint64_t HighestEquivalent(size_t index) const noexcept {
+    const uint64_t full = uint64_t{1} << sub_bucket_bits_;
+    if (index < full) {
+      return index;
+    }
+    const uint64_t half = full >> 1;
+    const uint64_t shift = (index - full) / half + 1;
+    const uint64_t sub = index - shift * half;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  [[nodiscard]] size_t Clamp(uint64_t value) const noexcept {
+    return Index(std::min(value, max_value_));
+  }
+
+ private:
+  static uint32_t HighestBit(uint64_t value) noexcept {
+    const auto high = static_cast<uint32_t>(value >> 32);
+    return 0 != high ? 32 + simd::detail::HighestBit(high)
+                     : simd::detail::HighestBit(static_cast<uint32_t>(value));
+  }
+
+  uint32_t sub_bucket_bits_;
+  uint64_t max_value_;
+  size_t size_;
+};
+}  // namespace detail
+
+class HdrHistogram {
+ public:
+  // 默认覆盖 1 小时（以纳秒计）
+  explicit HdrHistogram(uint64_t max_value = 3600000000000,
+                        int significant_digits = 2)
+      : layout_(max_value, significant_digits), counts_(layout_.size(), 0) {}
+
+  void Record(uint64_t value) noexcept { Record(value, 1); }
+
+  void Record(uint64_t value, uint64_t count) noexcept {
+    counts_[layout_.Clamp(value)] += count;
+    total_ += count;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  // other 的 max_value 和精度必须相同
+  void Merge(const HdrHistogram& other) noexcept {
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  void Reset() noexcept {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+  }
+
+  [[nodiscard]] uint64_t count() const noexcept { return total_; }
+  [[nodiscard]] bool empty() const noexcept { return 0 == total_; }
+
+  [[nodiscard]] uint64_t Min() const noexcept { return empty() ? 0 : min_; }
+  [[nodiscard]] uint64_t Max() const noexcept { return max_; }
+
+  [[nodiscard]] double Mean() const noexcept {
+    if (empty()) {
+      return 0;
+    }
+    double sum = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      if (0 != counts_[i]) {
+        sum += static_cast<double>(counts_[i]) *
+               static_cast<double>(layout_.HighestEquivalent(i));
+      }
+    }
+    return std::min(sum / static_cast<double>(total_),
+                    static_cast<double>(max_));
+  }
+
+  // percentile 取值 [0, 100]，返回不小于该比例样本的值（桶的上界，不超过 Max）
+  [[nodiscard]] uint64_t Percentile(double percentile) const noexcept {
+    if (empty()) {
+      return 0;
+    }
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    auto target = static_cast<uint64_t>(
+        percentile / 100 * static_cast<double>(total_) + 0.5);
+    target = std::clamp<uint64_t>(target, 1, total_);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= target) {
+        return std::clamp(layout_.HighestEquivalent(i), Min(), max_);
+      }
+    }
+    return max_;
+  }
+
+  [[nodiscard]] uint64_t P50() const noexcept { return Percentile(50); }
+  [[nodiscard]] uint64_t P99() const noexcept { return Percentile(99); }
+  [[nodiscard]] uint64_t P999() const noexcept { return Percentile(99.9); }
+
+  // 计数数组占用的字节数
+  [[nodiscard]] size_t memory_size() const noexcept {
+    return counts_.size() * sizeof(uint64_t);
+  }
+
+ private:
+  friend class ConcurrentHdrHistogram;
+
+  explicit HdrHistogram(const detail::HistogramLayout& layout)
+      : layout_(layout), counts_(layout_.size(), 0) {}
+
+  detail::HistogramLayout layout_;
+  std::vector<uint64_t> counts_;
+  uint64_t total_ = 0;
+  uint64_t min_ = UINT64_MAX;
+  uint64_t max_ = 0;
+};
+
+// 多线程版本：线程按编号落到固定个数的分片，分片内 relaxed 原子加，
+// 读时把分片合并成一个 HdrHistogram，读写都不加锁
+class ConcurrentHdrHistogram {
+ public:
+  explicit ConcurrentHdrHistogram(uint64_t max_value = 3600000000000,
+                                  int significant_digits = 2,
+                                  size_t shard_count = 8)
+      : layout_(max_value, significant_digits) {
+    shard_count = std::max<size_t>(shard_count, 1);
+    while (0 != (shard_count & (shard_count - 1))) {
+      ++shard_count;
+    }
+    shard_mask_ = shard_count - 1;
+    shards_.reset(new Shard[shard_count]);
+    for (size_t i = 0; i < shard_count; ++i) {
+      shards_[i].counts.reset(new std::atomic<uint64_t>[layout_.size()]);
+      for (size_t j = 0; j < layout_.size(); ++j) {
+        shards_[i].counts[j].store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void Record(uint64_t value) noexcept {
+    Shard& shard = shards_[ThreadIndex() & shard_mask_];
+    shard.counts[layout_.Clamp(value)].fetch_add(1, std::memory_order_relaxed);
+    UpdateMin(&shard.min, value);
+    UpdateMax(&shard.max, value);
+  }
+
+  // 与 Record 并发时结果是某个近似时刻的快照
+  void Snapshot(HdrHistogram* result) const {
+    HdrHistogram merged(layout_);
+    for (size_t i = 0; i <= shard_mask_; ++i) {
+      const Shard& shard = shards_[i];
+      for (size_t j = 0; j < layout_.size(); ++j) {
+        merged.counts_[j] += shard.counts[j].load(std::memory_order_relaxed);
+      }
+      merged.min_ =
+          std::min(merged.min_, shard.min.load(std::memory_order_relaxed));
+      merged.max_ =
+          std::max(merged.max_, shard.max.load(std::memory_order_relaxed));
+    }
+    // total 用各桶之和，和桶保持一致
+    for (const uint64_t count : merged.counts_) {
+      merged.total_ += count;
+    }
+    *result = std::move(merged);
+  }
+
+  [[nodiscard]] HdrHistogram Snapshot() const {
+    HdrHistogram result(layout_);
+    Snapshot(&result);
+    return result;
+  }
+
+  // 与 Record 并发时可能留下少量计数
+  void Reset() noexcept {
+    for (size_t i = 0; i <= shard_mask_; ++i) {
+      Shard& shard = shards_[i];
+      for (size_t j = 0; j < layout_.size(); ++j) {
+        shard.counts[j].store(0, std::memory_order_relaxed);
+      }
+      shard.min.store(UINT64_MAX, std::memory_order_relaxed);
+      shard.max.store(0, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  // 分片各占独立的缓存行
+  struct alignas(64) Shard {
+    std::unique_ptr<std::atomic<uint64_t>[]> counts;
+    std::atomic<uint64_t> min{UINT64_MAX};
+    std::atomic<uint64_t> max{0};
+  };
+
+  static size_t ThreadIndex() noexcept {
+    static std::atomic<size_t> next{0};
+    static thread_local const size_t index =
+        next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+  }
+
+  static void UpdateMin(std::atomic<uint64_t>* min, uint64_t value) noexcept {
+    uint64_t current = min->load(std::memory_order_relaxed);
+    while (value < current &&
+           !min->compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+    }
+  }
+
+  static void UpdateMax(std::atomic<uint64_t>* max, uint64_t value) noexcept {
+    uint64_t current = max->load(std::memory_order_relaxed);
+    while (value > current &&
+           !max->compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+    }
+  }
+
+  detail::HistogramLayout layout_;
+  size_t shard_mask_;
+  std::unique_ptr<Shard[]> shards_;
+
+  // noncopyable
+  ConcurrentHdrHistogram(const ConcurrentHdrHistogram&) = delete;
+  ConcurrentHdrHistogram& operator=(const ConcurrentHdrHistogram&) = delete;
+};
+
+// 析构时把经过的纳秒数记入直方图：
+//   static umu::ConcurrentHdrHistogram latency;
+//   umu::HistogramTimeMeasure<> measure(latency);
+template <class Clock = SystemClock, class HistogramType = ConcurrentHdrHistogram>
+class HistogramTimeMeasure {
+ public:
+  explicit HistogramTimeMeasure(HistogramType& histogram) noexcept
+      : histogram_(histogram), start_time_(Clock::Start()) {}
+
+  ~HistogramTimeMeasure() {
+    histogram_.Record(Clock::ToNanoseconds(Clock::Stop() - start_time_));
+  }
+
+ private:
+  HistogramType& histogram_;
+  uint64_t start_time_;
+
+  HistogramTimeMeasure(const HistogramTimeMeasure&) = delete;
+  HistogramTimeMeasure& operator=(const HistogramTimeMeasure&) = delete;
+};
+}  // namespace umu
@@ -0,0 +1,395 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace umu {
+// 超出容量时的处理方式：
+// inplace_overflow_error：操作不生效，置 overflow() 标志（一直保留到 clear）
+// inplace_overflow_spill：转存到堆上，之后和 std::basic_string 一样增长
+struct inplace_overflow_error {};
+struct inplace_overflow_spill {};
+
+// 内联 N 个字符（另加 '\0'）的字符串，接口是 std::basic_string 的常用子集。
+// 结果几乎总在 MAX_PATH 以内的 API 用它可以不分配内存：
+//   umu::inplace_basic_string<TCHAR, MAX_PATH> path;
+//   umu::apppath::GetProgramPath(&path);
+template <typename CharType,
+          size_t N,
+          class OverflowPolicy = inplace_overflow_error>
+class inplace_basic_string {
+ public:
+  using value_type = CharType;
+  using size_type = size_t;
+  using traits_type = std::char_traits<CharType>;
+  using iterator = CharType*;
+  using const_iterator = const CharType*;
+  using view_type = std::basic_string_view<CharType>;
+
+  static constexpr size_type npos = view_type::npos;
+  static constexpr bool kSpill =
+      std::is_same_v<OverflowPolicy, inplace_overflow_spill>;
+
+  inplace_basic_string() noexcept { buffer_[0] = 0; }
+
+  inplace_basic_string(view_type s) : inplace_basic_string() { assign(s); }
+
+  inplace_basic_string(const CharType* s)
+      : inplace_basic_string(view_type(s)) {}
+
+  inplace_basic_string(size_type count, CharType c) : inplace_basic_string() {
+    append(count, c);
+  }
+
+  inplace_basic_string(const inplace_basic_string& other)
+      : inplace_basic_string() {
+    assign(other.view());
+    overflow_ = other.overflow_;
+  }
+
+  inplace_basic_string(inplace_basic_string&& other) noexcept
+      : inplace_basic_string() {
+    *this = std::move(other);
+  }
+
+  inplace_basic_string& operator=(const inplace_basic_string& other) {
+    if (this != &other) {
+      assign(other.view());
+      overflow_ = other.overflow_;
+    }
+    return *this;
+  }
+
+  // 堆上的内容直接接管
+  inplace_basic_string& operator=(inplace_basic_string&& other) noexcept {
+    if (this != &other) {
+      if (nullptr != other.heap_) {
+        heap_ = std::move(other.heap_);
+        data_ = heap_.get();
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        other.data_ = other.buffer_;
+        other.capacity_ = N;
+        other.size_ = 0;
+        other.buffer_[0] = 0;
+      } else {
+        assign(other.view());
+      }
+      overflow_ = other.overflow_;
+    }
+    return *this;
+  }
+
+  inplace_basic_string& operator=(view_type s) { return assign(s); }
+
+  [[nodiscard]] size_type size() const noexcept { return size_; }
+  [[nodiscard]] size_type length() const noexcept { return size_; }
+  [[nodiscard]] size_type capacity() const noexcept { return capacity_; }
+  [[nodiscard]] static constexpr size_type inplace_capacity() noexcept {
+    return N;
+  }
+  [[nodiscard]] bool empty() const noexcept { return 0 == size_; }
+
+  // 内容仍在内联缓冲区中
+  [[nodiscard]] bool is_inplace() const noexcept { return data_ == buffer_; }
+
+  // error 策略下曾有操作因容量不足被忽略
+  [[nodiscard]] bool overflow() const noexcept { return overflow_; }
+
+  [[nodiscard]] CharType* data() noexcept { return data_; }
+  [[nodiscard]] const CharType* data() const noexcept { return data_; }
+  [[nodiscard]] const CharType* c_str() const noexcept { return data_; }
+
+  [[nodiscard]] iterator begin() noexcept { return data_; }
+  [[nodiscard]] iterator end() noexcept { return data_ + size_; }
+  [[nodiscard]] const_iterator begin() const noexcept { return data_; }
+  [[nodiscard]] const_iterator end() const noexcept { return data_ + size_; }
+
+  [[nodiscard]] CharType& operator[](size_type i) noexcept { return data_[i]; }
+  [[nodiscard]] CharType operator[](size_type i) const noexcept {
+    return data_[i];
+  }
+  [[nodiscard]] CharType& front() noexcept { return data_[0]; }
+  [[nodiscard]] CharType front() const noexcept { return data_[0]; }
+  [[nodiscard]] CharType& back() noexcept { return data_[size_ - 1]; }
+  [[nodiscard]] CharType back() const noexcept { return data_[size_ - 1]; }
+
+  [[nodiscard]] view_type view() const noexcept { return {data_, size_}; }
+  operator view_type() const noexcept { return {data_, size_}; }
+
+  [[nodiscard]] std::basic_string<CharType> str() const {
+    return {data_, size_};
+  }
+
+  // 保证能放下 new_capacity 个字符，失败时返回 false（error 策略）
+  bool reserve(size_type new_capacity) {
+    if (new_capacity <= capacity_) {
+      return true;
+    }
+    if constexpr (kSpill) {
+      new_capacity = std::max(new_capacity, capacity_ * 2);
+      std::unique_ptr<CharType[]> heap(new CharType[new_capacity + 1]);
+      traits_type::copy(heap.get(), data_, size_ + 1);
+      heap_ = std::move(heap);
+      data_ = heap_.get();
+      capacity_ = new_capacity;
+      return true;
+    } else {
+      overflow_ = true;
+      return false;
+    }
+  }
+
+  // 新增的字符为 c。常用于先按容量 resize，交给系统 API 写入，再按实际长度 resize
+  void resize(size_type count, CharType c = CharType()) {
+    if (size_ < count) {
+      if (!reserve(count)) {
+        return;
+      }
+      traits_type::assign(data_ + size_, count - size_, c);
+    }
+    size_ = count;
+    data_[size_] = 0;
+  }
+
+  // 和 resize 相同，但新增部分不初始化，用于交给系统 API 写入：
+  //   s.resize_for_overwrite(s.capacity());
+  //   DWORD size = ::GetTempPath(DWORD(s.capacity() + 1), s.data());
+  //   s.resize(size);
+  void resize_for_overwrite(size_type count) {
+    if (reserve(count)) {
+      size_ = count;
+      data_[size_] = 0;
+    }
+  }
+
+  void clear() noexcept {
+    size_ = 0;
+    data_[0] = 0;
+    overflow_ = false;
+  }
+
+  inplace_basic_string& assign(view_type s) {
+    if (!reserve(s.size())) {
+      return *this;
+    }
+    // s 可能指向自身
+    traits_type::move(data_, s.data(), s.size());
+    size_ = s.size();
+    data_[size_] = 0;
+    return *this;
+  }
+
+  inplace_basic_string& append(view_type s) {
+    if (s.size() > capacity_ - size_) {
+      // s 可能指向自身，spill 后要改指向新的缓冲区
+      const bool self = std::less_equal<const CharType*>()(data_, s.data()) &&
+                        std::less_equal<const CharType*>()(s.data(),
+                                                           data_ + size_);
+      const size_type offset = self ? s.data() - data_ : 0;
+      if (!reserve(size_ + s.size())) {
+        return *this;
+      }
+      if (self) {
+        s = view_type(data_ + offset, s.size());
+      }
+    }
+    traits_type::copy(data_ + size_, s.data(), s.size());
+    size_ += s.size();
+    data_[size_] = 0;
+    return *this;
+  }
+
+  inplace_basic_string& append(size_type count, CharType c) {
+    if (count > capacity_ - size_ && !reserve(size_ + count)) {
+      return *this;
+    }
+    traits_type::assign(data_ + size_, count, c);
+    size_ += count;
+    data_[size_] = 0;
+    return *this;
+  }
+
+  void push_back(CharType c) { append(1, c); }
+
+  void pop_back() noexcept { data_[--size_] = 0; }
+
+  inplace_basic_string& operator+=(view_type s) { return append(s); }
+  inplace_basic_string& operator+=(CharType c) { return append(1, c); }
+
+  inplace_basic_string& erase(size_type pos = 0, size_type count = npos) {
+    pos = std::min(pos, size_);
+    count = std::min(count, size_ - pos);
+    traits_type::move(data_ + pos, data_ + pos + count, size_ - pos - count);
+    size_ -= count;
+    data_[size_] = 0;
+    return *this;
+  }
+
+  [[nodiscard]] view_type substr(size_type pos = 0,
+                                 size_type count = npos) const {
+    return view().substr(pos, count);
+  }
+
+  [[nodiscard]] size_type find(view_type s, size_type pos = 0) const noexcept {
+    return view().find(s, pos);
+  }
+  [[nodiscard]] size_type find(CharType c, size_type pos = 0) const noexcept {
+    return view().find(c, pos);
+  }
+  [[nodiscard]] size_type rfind(view_type s,
+                                size_type pos = npos) const noexcept {
+    return view().rfind(s, pos);
+  }
+  [[nodiscard]] size_type rfind(CharType c,
+                                size_type pos = npos) const noexcept {
+    return view().rfind(c, pos);
+  }
+
+  [[nodiscard]] int compare(view_type s) const noexcept {
+    return view().compare(s);
+  }
+
+ private:
+  CharType* data_ = buffer_;
+  size_type size_ = 0;
+  size_type capacity_ = N;
+  bool overflow_ = false;
+  std::unique_ptr<CharType[]> heap_;
+  CharType buffer_[N + 1];
+};
+
+// 和另一个 inplace_basic_string（任意 N、Policy）、std::basic_string、
+// basic_string_view 及 C 字符串比较内容
+template <typename CharType,
+          size_t N1,
+          class Policy1,
+          size_t N2,
+          class Policy2>
+[[nodiscard]] inline bool operator==(
+    const inplace_basic_string<CharType, N1, Policy1>& lhs,
+    const inplace_basic_string<CharType, N2, Policy2>& rhs) noexcept {
+  return lhs.view() == rhs.view();
+}
+
+template <typename CharType,
+          size_t N1,
+          class Policy1,
+          size_t N2,
+          class Policy2>
+[[nodiscard]] inline bool operator!=(
+    const inplace_basic_string<CharType, N1, Policy1>& lhs,
+    const inplace_basic_string<CharType, N2, Policy2>& rhs) noexcept {
+  return lhs.view() != rhs.view();
+}
+
+template <typename CharType,
+          size_t N,
+          class Policy,
+          class Traits,
+          class Allocator>
+[[nodiscard]] inline bool operator==(
+    const inplace_basic_string<CharType, N, Policy>& lhs,
+    const std::basic_string<CharType, Traits, Allocator>& rhs) noexcept {
+  return lhs.view() == std::basic_string_view<CharType>(rhs);
+}
+
+template <typename CharType,
+          size_t N,
+          class Policy,
+          class Traits,
+          class Allocator>
+[[nodiscard]] inline bool operator!=(
+    const inplace_basic_string<CharType, N, Policy>& lhs,
+    const std::basic_string<CharType, Traits, Allocator>& rhs) noexcept {
+  return lhs.view() != std::basic_string_view<CharType>(rhs);
+}
+
+template <typename CharType,
+          size_t N,
+          class Policy,
+          class Traits,
+          class Allocator>
+[[nodiscard]] inline bool operator==(
+    const std::basic_string<CharType, Traits, Allocator>& lhs,
+    const inplace_basic_string<CharType, N, Policy>& rhs) noexcept {
+  return std::basic_string_view<CharType>(lhs) == rhs.view();
+}
+
+template <typename CharType,
+          size_t N,
+          class Policy,
+          class Traits,
+          class Allocator>
+[[nodiscard]] inline bool operator!=(
+    const std::basic_string<CharType, Traits, Allocator>& lhs,
+    const inplace_basic_string<CharType, N, Policy>& rhs) noexcept {
+  return std::basic_string_view<CharType>(lhs) != rhs.view();
+}
+
+template <typename CharType, size_t N, class Policy>
+[[nodiscard]] inline bool operator==(
+    const inplace_basic_string<CharType, N, Policy>& lhs,
+    std::basic_string_view<CharType> rhs) noexcept {
+  return lhs.view() == rhs;
+}
+
+template <typename CharType, size_t N, class Policy>
+[[nodiscard]] inline bool operator!=(
+    const inplace_basic_string<CharType, N, Policy>& lhs,
+    std::basic_string_view<CharType> rhs) noexcept {
+  return lhs.view() != rhs;
+}
+
+template <typename CharType, size_t N, class Policy>
+[[nodiscard]] inline bool operator==(
+    std::basic_string_view<CharType> lhs,
+    const inplace_basic_string<CharType, N, Policy>& rhs) noexcept {
+  return lhs == rhs.view();
+}
+
+template <typename CharType, size_t N, class Policy>
+[[nodiscard]] inline bool operator!=(
+    std::basic_string_view<CharType> lhs,
+    const inplace_basic_string<CharType, N, Policy>& rhs) noexcept {
+  return lhs != rhs.view();
+}
+
+template <typename CharType, size_t N, class Policy>
+[[nodiscard]] inline bool operator==(
+    const inplace_basic_string<CharType, N, Policy>& lhs,
+    const CharType* rhs) noexcept {
+  return lhs.view() == rhs;
+}
+
+template <typename CharType, size_t N, class Policy>
+[[nodiscard]] inline bool operator!=(
+    const inplace_basic_string<CharType, N, Policy>& lhs,
+    const CharType* rhs) noexcept {
+  return lhs.view() != rhs;
+}
+
+template <typename CharType, size_t N, class Policy>
+[[nodiscard]] inline bool operator==(
+    const CharType* lhs,
+    const inplace_basic_string<CharType, N, Policy>& rhs) noexcept {
+  return lhs == rhs.view();
+}
+
+template <typename CharType, size_t N, class Policy>
+[[nodiscard]] inline bool operator!=(
+    const CharType* lhs,
+    const inplace_basic_string<CharType, N, Policy>& rhs) noexcept {
+  return lhs != rhs.view();
+}
+
+template <size_t N, class Policy = inplace_overflow_error>
+using inplace_string = inplace_basic_string<char, N, Policy>;
+template <size_t N, class Policy = inplace_overflow_error>
+using inplace_wstring = inplace_basic_string<wchar_t, N, Policy>;
+}  // namespace umu
@@ -0,0 +1,225 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "simd.h"
+
+namespace umu {
+namespace string {
+// 字符串驻留池：相同内容只存一份，返回的 handle 是连续的整数，
+// 比较 handle 即比较字符串。字符串放在只增不减的 arena 中，
+// View 返回的 view 在池的生命周期内一直有效，末尾带 '\0'
+template <typename CharType>
+class InternPool {
+ public:
+  using view_type = std::basic_string_view<CharType>;
+  using Handle = uint32_t;
+
+  static constexpr Handle kInvalidHandle = UINT32_MAX;
+
+  InternPool() = default;
+
+  ~InternPool() {
+    for (auto& segment : segments_) {
+      delete[] segment.load(std::memory_order_relaxed);
+    }
+  }
+
+  Handle Intern(view_type s) {
+    const size_t hash = std::hash<view_type>()(s);
+    Handle handle;
+    if (Find(s, hash, &handle)) {
+      return handle;
+    }
+    return Insert(s, hash);
+  }
+
+  [[nodiscard]] bool Find(view_type s, Handle* handle) const {
+    return Find(s, std::hash<view_type>()(s), handle);
+  }
+
+  // handle 必须来自本池
+  [[nodiscard]] view_type View(Handle handle) const noexcept {
+    const auto [segment, offset] = Locate(handle);
+    return segments_[segment].load(std::memory_order_acquire)[offset];
+  }
+
+  [[nodiscard]] size_t size() const noexcept {
+    return size_.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return 0 == size(); }
+
+  // arena 占用的字符数
+  [[nodiscard]] size_t capacity() const noexcept { return arena_capacity_; }
+
+ protected:
+  bool Find(view_type s, size_t hash, Handle* handle) const {
+    if (slots_.empty()) {
+      return false;
+    }
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      const Slot& slot = slots_[i];
+      if (kInvalidHandle == slot.handle) {
+        return false;
+      }
+      if (slot.hash == hash && View(slot.handle) == s) {
+        *handle = slot.handle;
+        return true;
+      }
+    }
+  }
+
+  // 调用者保证 s 不在池中，池满时返回 kInvalidHandle
+  Handle Insert(view_type s, size_t hash) {
+    const size_t size = size_.load(std::memory_order_relaxed);
+    if (size >= kMaxSize) {
+      return kInvalidHandle;
+    }
+    const auto handle = static_cast<Handle>(size);
+    // 装载因子不超过 1/2
+    if (2 * (handle + 1) > slots_.size()) {
+      Rehash(std::max<size_t>(kMinSlotCount, 2 * slots_.size()));
+    }
+
+    CharType* data = Allocate(s.size() + 1);
+    std::copy(s.begin(), s.end(), data);
+    data[s.size()] = CharType();
+
+    const auto [segment, offset] = Locate(handle);
+    view_type* views = segments_[segment].load(std::memory_order_relaxed);
+    if (nullptr == views) {
+      views = new view_type[kFirstSegmentSize << segment];
+      segments_[segment].store(views, std::memory_order_release);
+    }
+    views[offset] = view_type(data, s.size());
+
+    const size_t mask = slots_.size() - 1;
+    size_t i = hash & mask;
+    while (kInvalidHandle != slots_[i].handle) {
+      i = (i + 1) & mask;
+    }
+    slots_[i] = {hash, handle};
+    size_.store(handle + 1, std::memory_order_release);
+    return handle;
+  }
+
+ private:
+  struct Slot {
+    size_t hash;
+    Handle handle;
+  };
+
+  static constexpr size_t kMinSlotCount = 64;
+  static constexpr size_t kArenaChunkSize = 64 * 1024 / sizeof(CharType);
+  // 第 n 段有 kFirstSegmentSize << n 个元素，段一旦分配就不再移动
+  static constexpr uint32_t kFirstSegmentBits = 10;
+  static constexpr uint32_t kFirstSegmentSize = 1U << kFirstSegmentBits;
+  static constexpr size_t kSegmentCount = 32 - kFirstSegmentBits;
+  static constexpr size_t kMaxSize = UINT32_MAX - kFirstSegmentSize;
+
+  static std::pair<size_t, size_t> Locate(Handle handle) noexcept {
+    const uint32_t x = handle + kFirstSegmentSize;
+    const uint32_t bit = simd::detail::HighestBit(x);
+    return {bit - kFirstSegmentBits, x - (1U << bit)};
+  }
+
+  void Rehash(size_t slot_count) {
+    std::vector<Slot> slots(slot_count, Slot{0, kInvalidHandle});
+    const size_t mask = slot_count - 1;
+    for (const Slot& slot : slots_) {
+      if (kInvalidHandle != slot.handle) {
+        size_t i = slot.hash & mask;
+        while (kInvalidHandle != slots[i].handle) {
+          i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+      }
+    }
+    slots_.swap(slots);
+  }
+
+  CharType* Allocate(size_t size) {
+    if (size > arena_remaining_) {
+      const size_t chunk_size = std::max(kArenaChunkSize, size);
+      chunks_.emplace_back(new CharType[chunk_size]);
+      arena_next_ = chunks_.back().get();
+      arena_remaining_ = chunk_size;
+      arena_capacity_ += chunk_size;
+    }
+    CharType* data = arena_next_;
+    arena_next_ += size;
+    arena_remaining_ -= size;
+    return data;
+  }
+
+  std::vector<Slot> slots_;
+  std::atomic<view_type*> segments_[kSegmentCount]{};
+  std::atomic<size_t> size_{0};
+
+  std::vector<std::unique_ptr<CharType[]>> chunks_;
+  CharType* arena_next_ = nullptr;
+  size_t arena_remaining_ = 0;
+  size_t arena_capacity_ = 0;
+
+  // noncopyable
+  InternPool(const InternPool&) = delete;
+  InternPool& operator=(const InternPool&) = delete;
+};
+
+// 多线程版本：查找持共享锁，插入持独占锁，View 不加锁
+template <typename CharType>
+class ConcurrentInternPool : private InternPool<CharType> {
+  using Base = InternPool<CharType>;
+
+ public:
+  using typename Base::Handle;
+  using typename Base::view_type;
+  using Base::kInvalidHandle;
+  using Base::View;
+  using Base::empty;
+  using Base::size;
+
+  Handle Intern(view_type s) {
+    const size_t hash = std::hash<view_type>()(s);
+    Handle handle;
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      if (Base::Find(s, hash, &handle)) {
+        return handle;
+      }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // 两次加锁之间可能已被其他线程插入
+    if (Base::Find(s, hash, &handle)) {
+      return handle;
+    }
+    return Base::Insert(s, hash);
+  }
+
+  [[nodiscard]] bool Find(view_type s, Handle* handle) const {
+    const size_t hash = std::hash<view_type>()(s);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return Base::Find(s, hash, handle);
+  }
+
+  [[nodiscard]] size_t capacity() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return Base::capacity();
+  }
+
+ private:
+  mutable std::shared_mutex mutex_;
+};
+}  // end of namespace string
+}  // end of namespace umu
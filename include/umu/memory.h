@@ -1,4 +1,19 @@
-#pragma once
+﻿#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace umu {
 namespace memory {
@@ -6,5 +21,551 @@ static inline void* GetVTableFunctionAddress(void* class_ptr, size_t offset) {
   void** vtable = *(void***)class_ptr;
   return vtable[offset];
 }
+
+// 单调 arena：只增不减，Allocate 只移动指针，Deallocate 什么也不做，
+// Reset 时整体回收。当前 chunk 不够时按两倍申请新 chunk，不超过 max_chunk_size
+// （更大的请求单独占一个 chunk）。非线程安全，适合一个请求一个 arena：
+//   umu::memory::MonotonicArena arena;
+//   void* p = arena.Allocate(size);
+//   ...
+//   arena.Reset();
+class MonotonicArena {
+ public:
+  explicit MonotonicArena(size_t initial_size = 4096,
+                          size_t max_chunk_size = 1 << 20) noexcept
+      : next_chunk_size_(std::max<size_t>(initial_size, sizeof(Chunk) + 16)),
+        max_chunk_size_(std::max(max_chunk_size, next_chunk_size_)) {}
+
+  // 先用调用者提供的 buffer（例如栈上数组），用完再向系统申请。buffer 不会被释放
+  MonotonicArena(void* buffer,
+                 size_t size,
+                 size_t max_chunk_size = 1 << 20) noexcept
+      : MonotonicArena(std::max<size_t>(size, 4096), max_chunk_size) {
+    initial_buffer_ = static_cast<char*>(buffer);
+    initial_size_ = size;
+    cursor_ = initial_buffer_;
+    end_ = initial_buffer_ + size;
+  }
+
+  ~MonotonicArena() { Release(); }
+
+  // 失败时返回 nullptr。alignment 必须是 2 的幂
+  [[nodiscard]] void* Allocate(
+      size_t size,
+      size_t alignment = alignof(std::max_align_t)) noexcept {
+    char* p = AlignUp(cursor_, alignment);
+    const auto padding = static_cast<size_t>(p - cursor_);
+    const auto remaining = static_cast<size_t>(end_ - cursor_);
+    if (nullptr == cursor_ || remaining < padding ||
+        remaining - padding < size) {
+      if (SIZE_MAX - alignment < size || !NewChunk(size + alignment)) {
+        return nullptr;
+      }
+      p = AlignUp(cursor_, alignment);
+    }
+    cursor_ = p + size;
+    used_ += size;
+    return p;
+  }
+
+  template <typename T>
+  [[nodiscard]] T* AllocateArray(size_t count) noexcept {
+    return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  // 之前分配的内存全部失效。保留最大的一个 chunk，其余还给系统；
+  // 有调用者提供的 buffer 时从 buffer 重新开始，保留的 chunk 等 buffer 用完再用
+  void Reset() noexcept {
+    Chunk* largest = spare_;
+    for (Chunk* chunk = chunks_; nullptr != chunk; chunk = chunk->next) {
+      if (nullptr == largest || largest->size < chunk->size) {
+        largest = chunk;
+      }
+    }
+    for (Chunk* chunk = chunks_; nullptr != chunk;) {
+      Chunk* next = chunk->next;
+      if (chunk != largest) {
+        std::free(chunk);
+      }
+      chunk = next;
+    }
+    if (nullptr != spare_ && spare_ != largest) {
+      std::free(spare_);
+    }
+    chunks_ = nullptr;
+    spare_ = nullptr;
+    capacity_ = 0;
+    cursor_ = nullptr;
+    end_ = nullptr;
+    if (nullptr != largest) {
+      largest->next = nullptr;
+      capacity_ = largest->size - sizeof(Chunk);
+    }
+    if (nullptr != initial_buffer_) {
+      spare_ = largest;
+      cursor_ = initial_buffer_;
+      end_ = initial_buffer_ + initial_size_;
+    } else if (nullptr != largest) {
+      chunks_ = largest;
+      cursor_ = reinterpret_cast<char*>(largest + 1);
+      end_ = reinterpret_cast<char*>(largest) + largest->size;
+    }
+    used_ = 0;
+  }
+
+  // 所有 chunk 还给系统
+  void Release() noexcept {
+    FreeChunks(chunks_);
+    FreeChunks(spare_);
+    chunks_ = nullptr;
+    spare_ = nullptr;
+    Reset();
+  }
+
+  // 分配出去的字节数，不含对齐填充
+  [[nodiscard]] size_t used() const noexcept { return used_; }
+
+  // 持有的 chunk 的可用字节数之和，不含 initial buffer
+  [[nodiscard]] size_t capacity() const noexcept { return capacity_; }
+
+ private:
+  struct alignas(std::max_align_t) Chunk {
+    Chunk* next;
+    size_t size;
+  };
+
+  static char* AlignUp(char* p, size_t alignment) noexcept {
+    const auto address = reinterpret_cast<uintptr_t>(p);
+    return p + ((alignment - (address & (alignment - 1))) & (alignment - 1));
+  }
+
+  bool NewChunk(size_t min_size) noexcept {
+    // Reset 时保留下来的 chunk
+    if (nullptr != spare_ && min_size <= spare_->size - sizeof(Chunk)) {
+      Chunk* chunk = spare_;
+      spare_ = nullptr;
+      chunk->next = chunks_;
+      chunks_ = chunk;
+      cursor_ = reinterpret_cast<char*>(chunk + 1);
+      end_ = reinterpret_cast<char*>(chunk) + chunk->size;
+      return true;
+    }
+    size_t size = next_chunk_size_;
+    if (size - sizeof(Chunk) < min_size) {
+      size = min_size + sizeof(Chunk);
+      if (size < min_size) {
+        return false;
+      }
+    } else {
+      next_chunk_size_ = std::min(next_chunk_size_ * 2, max_chunk_size_);
+    }
+    auto chunk = static_cast<Chunk*>(std::malloc(size));
+    if (nullptr == chunk) {
+      return false;
+    }
+    chunk->next = chunks_;
+    chunk->size = size;
+    chunks_ = chunk;
+    cursor_ = reinterpret_cast<char*>(chunk + 1);
+    end_ = reinterpret_cast<char*>(chunk) + size;
+    capacity_ += size - sizeof(Chunk);
+    return true;
+  }
+
+  static void FreeChunks(Chunk* chunk) noexcept {
+    while (nullptr != chunk) {
+      Chunk* next = chunk->next;
+      std::free(chunk);
+      chunk = next;
+    }
+  }
+
+  char* cursor_ = nullptr;
+  char* end_ = nullptr;
+  Chunk* chunks_ = nullptr;
+  // Reset 后保留、还没有使用的 chunk
+  Chunk* spare_ = nullptr;
+  char* initial_buffer_ = nullptr;
+  size_t initial_size_ = 0;
+  size_t next_chunk_size_;
+  size_t max_chunk_size_;
+  size_t used_ = 0;
+  size_t capacity_ = 0;
+
+  // noncopyable
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+};
+
+// 按 2 的幂分级（16 ~ 4096 字节）的内存池，每级一个空闲链表，
+// 释放的块挂回链表，不还给系统。更大的或对齐要求超过 max_align_t 的请求
+// 直接走 operator new。非线程安全；ThreadLocal() 返回当前线程的实例，
+// 从它分配的内存必须在同一线程、线程退出前释放
+class SizeClassPool {
+ public:
+  static constexpr size_t kMinBlockSize = 16;
+  static constexpr size_t kMaxBlockSize = 4096;
+  static constexpr size_t kClassCount = 9;
+
+  explicit SizeClassPool(size_t chunk_size = 64 * 1024) noexcept
+      : arena_(chunk_size, chunk_size) {}
+
+  static SizeClassPool& ThreadLocal() noexcept {
+    static thread_local SizeClassPool pool;
+    return pool;
+  }
+
+  // 失败时返回 nullptr
+  [[nodiscard]] void* Allocate(
+      size_t size,
+      size_t alignment = alignof(std::max_align_t)) noexcept {
+    if (kMaxBlockSize < size || alignof(std::max_align_t) < alignment) {
+      return ::operator new(size, std::align_val_t(alignment), std::nothrow);
+    }
+    const size_t index = ClassIndex(size);
+    FreeBlock* block = free_lists_[index];
+    if (nullptr != block) {
+      free_lists_[index] = block->next;
+      return block;
+    }
+    return arena_.Allocate(kMinBlockSize << index, alignof(std::max_align_t));
+  }
+
+  // size、alignment 必须和 Allocate 时一致
+  void Deallocate(void* p,
+                  size_t size,
+                  size_t alignment = alignof(std::max_align_t)) noexcept {
+    if (nullptr == p) {
+      return;
+    }
+    if (kMaxBlockSize < size || alignof(std::max_align_t) < alignment) {
+      ::operator delete(p, std::align_val_t(alignment));
+      return;
+    }
+    const size_t index = ClassIndex(size);
+    auto block = static_cast<FreeBlock*>(p);
+    block->next = free_lists_[index];
+    free_lists_[index] = block;
+  }
+
+  // 向系统申请的字节数
+  [[nodiscard]] size_t capacity() const noexcept { return arena_.capacity(); }
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  static size_t ClassIndex(size_t size) noexcept {
+    size_t index = 0;
+    while ((kMinBlockSize << index) < size) {
+      ++index;
+    }
+    return index;
+  }
+
+  MonotonicArena arena_;
+  FreeBlock* free_lists_[kClassCount]{};
+
+  // noncopyable
+  SizeClassPool(const SizeClassPool&) = delete;
+  SizeClassPool& operator=(const SizeClassPool&) = delete;
+};
+
+// 以下是 std::pmr::memory_resource 适配器，用于 std::pmr::string 等容器：
+//   umu::memory::ArenaResource arena;
+//   std::pmr::vector<std::pmr::string> fields(&arena);
+//   umu::string::Split(&fields, std::pmr::string(line, &arena), ',');
+// 容器必须在 resource 之前析构
+
+// 自带一个 MonotonicArena，deallocate 不做事，Reset 整体回收
+class ArenaResource : public std::pmr::memory_resource {
+ public:
+  explicit ArenaResource(size_t initial_size = 4096,
+                         size_t max_chunk_size = 1 << 20) noexcept
+      : arena_(initial_size, max_chunk_size) {}
+
+  ArenaResource(void* buffer,
+                size_t size,
+                size_t max_chunk_size = 1 << 20) noexcept
+      : arena_(buffer, size, max_chunk_size) {}
+
+  void Reset() noexcept { arena_.Reset(); }
+
+  [[nodiscard]] MonotonicArena& arena() noexcept { return arena_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    void* p = arena_.Allocate(bytes, alignment);
+    if (nullptr == p) {
+      throw std::bad_alloc();
+    }
+    return p;
+  }
+
+  void do_deallocate(void*, size_t, size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource& other)
+      const noexcept override {
+    return this == &other;
+  }
+
+  MonotonicArena arena_;
+};
+
+// 使用 SizeClassPool，默认是当前线程的实例
+class PoolResource : public std::pmr::memory_resource {
+ public:
+  explicit PoolResource(
+      SizeClassPool& pool = SizeClassPool::ThreadLocal()) noexcept
+      : pool_(pool) {}
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    void* p = pool_.Allocate(bytes, alignment);
+    if (nullptr == p) {
+      throw std::bad_alloc();
+    }
+    return p;
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    pool_.Deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other)
+      const noexcept override {
+    const auto resource = dynamic_cast<const PoolResource*>(&other);
+    return nullptr != resource && &resource->pool_ == &pool_;
+  }
+
+  SizeClassPool& pool_;
+};
+
+// 大块内存直接向系统映射，释放时立即归还系统，适合几百 MB 的工作缓冲区。
+// kLargeBufferHugePages：按 2MB 对齐并请求透明大页（Linux madvise），
+//   Windows 上有 SeLockMemoryPrivilege 时用 MEM_LARGE_PAGES，否则用普通页；
+// kLargeBufferPopulate：返回前把所有页面预先缺页，避免首次访问时卡顿
+constexpr uint32_t kLargeBufferHugePages = 1;
+constexpr uint32_t kLargeBufferPopulate = 2;
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+namespace detail {
+inline size_t PageSize() noexcept {
+#if defined(_WIN32)
+  static const size_t page_size = [] {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return static_cast<size_t>(info.dwPageSize);
+  }();
+#else
+  static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+  return page_size;
+}
+
+// 只依赖 size，FreeLargeBuffer 时才能算出同样的映射长度
+inline size_t LargeBufferMappedSize(size_t size) noexcept {
+  const size_t granularity = kHugePageSize <= size ? kHugePageSize : PageSize();
+  return (size + granularity - 1) / granularity * granularity;
+}
+
+// 每页写一个字节触发缺页，匿名映射的内容本来就是 0
+inline void TouchPages(void* p, size_t size) noexcept {
+  auto bytes = static_cast<volatile char*>(p);
+  const size_t page_size = PageSize();
+  for (size_t offset = 0; offset < size; offset += page_size) {
+    bytes[offset] = 0;
+  }
+}
+}  // namespace detail
+
+// 失败时返回 nullptr，内容全为 0
+[[nodiscard]] inline void* AllocateLargeBuffer(
+    size_t size,
+    uint32_t flags = kLargeBufferHugePages) noexcept {
+  if (0 == size) {
+    return nullptr;
+  }
+  const size_t mapped_size = detail::LargeBufferMappedSize(size);
+  if (mapped_size < size) {
+    return nullptr;
+  }
+  const bool huge = 0 != (flags & kLargeBufferHugePages) &&
+                    kHugePageSize <= mapped_size;
+#if defined(_WIN32)
+  void* p = nullptr;
+  if (huge) {
+    const size_t large_page_size = GetLargePageMinimum();
+    if (0 != large_page_size && 0 == mapped_size % large_page_size) {
+      p = VirtualAlloc(nullptr, mapped_size,
+                       MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                       PAGE_READWRITE);
+    }
+  }
+  if (nullptr == p) {
+    p = VirtualAlloc(nullptr, mapped_size, MEM_RESERVE | MEM_COMMIT,
+                     PAGE_READWRITE);
+    if (nullptr != p && 0 != (flags & kLargeBufferPopulate)) {
+      detail::TouchPages(p, mapped_size);
+    }
+  }
+  return p;
+#else
+  const bool populate = 0 != (flags & kLargeBufferPopulate);
+  if (!huge) {
+    int map_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_POPULATE)
+    if (populate) {
+      map_flags |= MAP_POPULATE;
+    }
+#endif
+    void* p = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, map_flags, -1,
+                   0);
+    return MAP_FAILED == p ? nullptr : p;
+  }
+
+  // 多映射 2MB，裁掉首尾，得到按大页对齐的区域
+  const size_t reserve_size = mapped_size + kHugePageSize;
+  void* reserved = mmap(nullptr, reserve_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == reserved) {
+    return nullptr;
+  }
+  const auto address = reinterpret_cast<uintptr_t>(reserved);
+  const uintptr_t aligned =
+      (address + kHugePageSize - 1) & ~uintptr_t{kHugePageSize - 1};
+  const size_t head = aligned - address;
+  const size_t tail = reserve_size - head - mapped_size;
+  if (0 < head) {
+    munmap(reserved, head);
+  }
+  if (0 < tail) {
+    munmap(reinterpret_cast<void*>(aligned + mapped_size), tail);
+  }
+  auto p = reinterpret_cast<void*>(aligned);
+#if defined(MADV_HUGEPAGE)
+  // 只是建议，THP 关闭时失败也没关系
+  madvise(p, mapped_size, MADV_HUGEPAGE);
+#endif
+  if (populate) {
+    // 先 madvise 再缺页，缺页时才会分配大页。
+    // MADV_POPULATE_WRITE（23）需要 5.14，旧内核返回 EINVAL 时逐页写
+    constexpr int kPopulateWrite = 23;
+    if (0 != madvise(p, mapped_size, kPopulateWrite)) {
+      detail::TouchPages(p, mapped_size);
+    }
+  }
+  return p;
+#endif
+}
+
+// size 必须和 AllocateLargeBuffer 时一致
+inline void FreeLargeBuffer(void* p, size_t size) noexcept {
+  if (nullptr == p) {
+    return;
+  }
+#if defined(_WIN32)
+  (void)size;
+  VirtualFree(p, 0, MEM_RELEASE);
+#else
+  munmap(p, detail::LargeBufferMappedSize(size));
+#endif
+}
+
+// AllocateLargeBuffer 的 RAII 封装，可移动
+class LargeBuffer {
+ public:
+  LargeBuffer() noexcept = default;
+
+  LargeBuffer(LargeBuffer&& other) noexcept
+      : data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)) {}
+
+  LargeBuffer& operator=(LargeBuffer&& other) noexcept {
+    if (this != &other) {
+      Release();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+
+  ~LargeBuffer() { Release(); }
+
+  // 原有的内存先释放
+  bool Allocate(size_t size, uint32_t flags = kLargeBufferHugePages) noexcept {
+    Release();
+    data_ = AllocateLargeBuffer(size, flags);
+    if (nullptr == data_) {
+      return false;
+    }
+    size_ = size;
+    return true;
+  }
+
+  void Release() noexcept {
+    FreeLargeBuffer(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  [[nodiscard]] void* data() const noexcept { return data_; }
+  [[nodiscard]] size_t size() const noexcept { return size_; }
+  [[nodiscard]] bool empty() const noexcept { return nullptr == data_; }
+
+ private:
+  void* data_ = nullptr;
+  size_t size_ = 0;
+
+  // noncopyable
+  LargeBuffer(const LargeBuffer&) = delete;
+  LargeBuffer& operator=(const LargeBuffer&) = delete;
+};
+
+// 标准容器的 allocator，每次 allocate 单独映射，只适合一次 reserve 到位的大数组：
+//   std::vector<std::string_view, umu::memory::LargeBufferAllocator<
+//       std::string_view>> tokens;
+//   tokens.reserve(count);
+template <class T, uint32_t kFlags = kLargeBufferHugePages>
+class LargeBufferAllocator {
+ public:
+  using value_type = T;
+
+  template <class U>
+  struct rebind {
+    using other = LargeBufferAllocator<U, kFlags>;
+  };
+
+  LargeBufferAllocator() noexcept = default;
+
+  template <class U>
+  LargeBufferAllocator(const LargeBufferAllocator<U, kFlags>&) noexcept {}
+
+  [[nodiscard]] T* allocate(size_t n) {
+    if (SIZE_MAX / sizeof(T) < n) {
+      throw std::bad_alloc();
+    }
+    void* p = AllocateLargeBuffer(n * sizeof(T), kFlags);
+    if (nullptr == p) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(p);
+  }
+
+  void deallocate(T* p, size_t n) noexcept {
+    FreeLargeBuffer(p, n * sizeof(T));
+  }
+
+  template <class U>
+  bool operator==(const LargeBufferAllocator<U, kFlags>&) const noexcept {
+    return true;
+  }
+
+  template <class U>
+  bool operator!=(const LargeBufferAllocator<U, kFlags>&) const noexcept {
+    return false;
+  }
+};
 }  // namespace memory
 }  // end of namespace umu
@@ -0,0 +1,374 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "memory.h"
+
+// 定长对象池：每个线程有两个 magazine（一批空闲对象指针）做本地缓存，
+// 本地缓存空了或满了才和全局仓库整批交换，仓库是无锁栈（带 tag 防 ABA）。
+// kConstructOnReuse 为 true 时 New/Delete 每次构造、析构对象；
+// 为 false 时对象只在第一次分配时默认构造，Acquire/Release 之间保留状态，
+// 池析构时统一析构。池析构前所有对象必须已归还。
+//   static umu::memory::ObjectPool<Context> pool;
+//   Context* context = pool.New(request);
+//   pool.Delete(context);
+namespace umu {
+namespace memory {
+namespace detail {
+// 无锁栈，head 的高位存 tag，每次修改加 1。
+// 节点的内存在池析构前不会释放，Pop 时读到已被别人取走的节点也安全
+template <class Node>
+class TaggedStack {
+ public:
+  void Push(Node* node) noexcept {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    do {
+      node->next.store(Pointer(head), std::memory_order_relaxed);
+    } while (!head_.compare_exchange_weak(head, Pack(node, Tag(head) + 1),
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+  }
+
+  Node* Pop() noexcept {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    for (Node* node = Pointer(head); nullptr != node; node = Pointer(head)) {
+      Node* next = node->next.load(std::memory_order_relaxed);
+      if (head_.compare_exchange_weak(head, Pack(next, Tag(head) + 1),
+                                      std::memory_order_acquire,
+                                      std::memory_order_acquire)) {
+        return node;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  // 64 位平台用户态地址只有 48 位，剩下 16 位放 tag
+  static constexpr uint32_t kPointerBits = 8 == sizeof(void*) ? 48 : 32;
+  static constexpr uint64_t kPointerMask = (uint64_t{1} << kPointerBits) - 1;
+
+  static uint64_t Pack(Node* node, uint64_t tag) noexcept {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node)) |
+           (tag << kPointerBits);
+  }
+
+  static Node* Pointer(uint64_t head) noexcept {
+    return reinterpret_cast<Node*>(static_cast<uintptr_t>(head & kPointerMask));
+  }
+
+  static uint64_t Tag(uint64_t head) noexcept { return head >> kPointerBits; }
+
+  std::atomic<uint64_t> head_{0};
+};
+
+// 给活着的线程分配互不相同的小编号，线程退出后编号回收。
+// 同一时刻一个编号只属于一个线程，按编号索引的缓存无需加锁
+class ThreadSlot {
+ public:
+  static constexpr size_t kCount = 256;
+
+  // 编号用完时返回 kCount
+  static size_t Current() noexcept {
+    static thread_local const ThreadSlot slot;
+    return slot.index_;
+  }
+
+ private:
+  ThreadSlot() noexcept {
+    std::lock_guard<std::mutex> lock(Mutex());
+    for (index_ = 0; index_ < kCount && Used()[index_]; ++index_) {
+    }
+    if (index_ < kCount) {
+      Used()[index_] = true;
+    }
+  }
+
+  ~ThreadSlot() {
+    if (index_ < kCount) {
+      std::lock_guard<std::mutex> lock(Mutex());
+      Used()[index_] = false;
+    }
+  }
+
+  static std::mutex& Mutex() noexcept {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static bool* Used() noexcept {
+    static bool used[kCount];
+    return used;
+  }
+
+  size_t index_;
+};
+}  // namespace detail
+
+struct ObjectPoolStats {
+  // 累计分配、归还的次数
+  uint64_t allocations = 0;
+  uint64_t deallocations = 0;
+  // 向系统申请的对象个数
+  uint64_t capacity = 0;
+  // 和全局仓库交换 magazine 的次数，越少说明本地缓存命中越好
+  uint64_t depot_exchanges = 0;
+
+  [[nodiscard]] uint64_t in_use() const noexcept {
+    return allocations - deallocations;
+  }
+};
+
+template <class T, bool kConstructOnReuse = true>
+class ObjectPool {
+ public:
+  static constexpr size_t kMagazineSize = 32;
+
+  ObjectPool() : caches_(new Cache[detail::ThreadSlot::kCount + 1]) {}
+
+  ~ObjectPool() {
+    delete[] caches_;
+    while (Magazine* magazine = full_.Pop()) {
+      delete magazine;
+    }
+    while (Magazine* magazine = empty_.Pop()) {
+      delete magazine;
+    }
+    for (Slab* slab = slabs_.load(std::memory_order_acquire);
+         nullptr != slab;) {
+      Slab* next = slab->next;
+      if constexpr (!kConstructOnReuse) {
+        for (size_t i = 0; i < kMagazineSize; ++i) {
+          slab->objects()[i].~T();
+        }
+      }
+      ::operator delete(slab, std::align_val_t(Slab::kAlignment));
+      slab = next;
+    }
+  }
+
+  // 失败时返回 nullptr；T 的构造函数抛出的异常会传出，对象归还池中
+  template <class... Args>
+  [[nodiscard]] T* New(Args&&... args) {
+    static_assert(kConstructOnReuse, "use Acquire()");
+    void* storage = Allocate();
+    if (nullptr == storage) {
+      return nullptr;
+    }
+    struct Guard {
+      ObjectPool* pool;
+      void* storage;
+      ~Guard() {
+        if (nullptr != storage) {
+          pool->Deallocate(storage);
+        }
+      }
+    } guard{this, storage};
+    T* object = new (storage) T(std::forward<Args>(args)...);
+    guard.storage = nullptr;
+    return object;
+  }
+
+  void Delete(T* object) noexcept {
+    static_assert(kConstructOnReuse, "use Release()");
+    if (nullptr != object) {
+      object->~T();
+      Deallocate(object);
+    }
+  }
+
+  // 返回上次 Release 时的对象，状态由调用者重置
+  [[nodiscard]] T* Acquire() noexcept {
+    static_assert(!kConstructOnReuse, "use New()");
+    return static_cast<T*>(Allocate());
+  }
+
+  void Release(T* object) noexcept {
+    static_assert(!kConstructOnReuse, "use Delete()");
+    if (nullptr != object) {
+      Deallocate(object);
+    }
+  }
+
+  // 各线程计数之和，并发时是近似值
+  [[nodiscard]] ObjectPoolStats stats() const noexcept {
+    ObjectPoolStats stats;
+    for (size_t i = 0; i <= detail::ThreadSlot::kCount; ++i) {
+      const Cache& cache = caches_[i];
+      stats.allocations += cache.allocations.load(std::memory_order_relaxed);
+      stats.deallocations +=
+          cache.deallocations.load(std::memory_order_relaxed);
+      stats.depot_exchanges +=
+          cache.depot_exchanges.load(std::memory_order_relaxed);
+    }
+    stats.capacity = capacity_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+ private:
+  struct Magazine {
+    std::atomic<Magazine*> next{nullptr};
+    size_t count = 0;
+    void* objects[kMagazineSize];
+  };
+
+  // 一次申请 kMagazineSize 个对象，头部串成链表，池析构时释放
+  struct Slab {
+    static constexpr size_t kAlignment =
+        alignof(T) < alignof(Slab*) ? alignof(Slab*) : alignof(T);
+    static constexpr size_t kHeaderSize =
+        (sizeof(Slab*) + kAlignment - 1) / kAlignment * kAlignment;
+    static constexpr size_t kSize = kHeaderSize + sizeof(T) * kMagazineSize;
+
+    T* objects() noexcept {
+      return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + kHeaderSize);
+    }
+
+    Slab* next;
+  };
+
+  // 编号为 kCount 的缓存给编号用完后的线程共用，要加锁
+  struct alignas(64) Cache {
+    Magazine* loaded = nullptr;
+    Magazine* previous = nullptr;
+    // 只有所属线程写，用原子变量是为了 stats() 可以并发读
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> deallocations{0};
+    std::atomic<uint64_t> depot_exchanges{0};
+
+    ~Cache() {
+      delete loaded;
+      delete previous;
+    }
+  };
+
+  static void Increase(std::atomic<uint64_t>* counter) noexcept {
+    counter->store(counter->load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  }
+
+  void* Allocate() noexcept {
+    const size_t slot = detail::ThreadSlot::Current();
+    if (detail::ThreadSlot::kCount == slot) {
+      std::lock_guard<std::mutex> lock(shared_mutex_);
+      return Allocate(&caches_[slot]);
+    }
+    return Allocate(&caches_[slot]);
+  }
+
+  void Deallocate(void* object) noexcept {
+    const size_t slot = detail::ThreadSlot::Current();
+    if (detail::ThreadSlot::kCount == slot) {
+      std::lock_guard<std::mutex> lock(shared_mutex_);
+      Deallocate(&caches_[slot], object);
+      return;
+    }
+    Deallocate(&caches_[slot], object);
+  }
+
+  // loaded、previous 不为空时，previous 要么满、要么空
+  void* Allocate(Cache* cache) noexcept {
+    if (nullptr == cache->loaded || 0 == cache->loaded->count) {
+      if (nullptr != cache->previous && 0 < cache->previous->count) {
+        std::swap(cache->loaded, cache->previous);
+      } else {
+        Magazine* full = full_.Pop();
+        if (nullptr == full) {
+          full = NewSlab();
+          if (nullptr == full) {
+            return nullptr;
+          }
+        }
+        Increase(&cache->depot_exchanges);
+        if (nullptr != cache->previous) {
+          empty_.Push(cache->previous);
+        }
+        cache->previous = cache->loaded;
+        cache->loaded = full;
+      }
+    }
+    Increase(&cache->allocations);
+    return cache->loaded->objects[--cache->loaded->count];
+  }
+
+  void Deallocate(Cache* cache, void* object) noexcept {
+    if (nullptr == cache->loaded || kMagazineSize == cache->loaded->count) {
+      if (nullptr != cache->previous && 0 == cache->previous->count) {
+        std::swap(cache->loaded, cache->previous);
+      } else {
+        Magazine* empty = empty_.Pop();
+        if (nullptr == empty) {
+          empty = new (std::nothrow) Magazine;
+        }
+        if (nullptr == empty) {
+          // 内存不足时放弃这个对象，它所在的 slab 在池析构时释放
+          Increase(&cache->deallocations);
+          return;
+        }
+        Increase(&cache->depot_exchanges);
+        if (nullptr != cache->previous) {
+          full_.Push(cache->previous);
+        }
+        cache->previous = cache->loaded;
+        cache->loaded = empty;
+      }
+    }
+    Increase(&cache->deallocations);
+    cache->loaded->objects[cache->loaded->count++] = object;
+  }
+
+  // 申请一批对象，装满一个 magazine 返回
+  Magazine* NewSlab() noexcept {
+    Magazine* magazine = empty_.Pop();
+    if (nullptr == magazine) {
+      magazine = new (std::nothrow) Magazine;
+      if (nullptr == magazine) {
+        return nullptr;
+      }
+    }
+    auto slab = static_cast<Slab*>(::operator new(
+        Slab::kSize, std::align_val_t(Slab::kAlignment), std::nothrow));
+    if (nullptr == slab) {
+      empty_.Push(magazine);
+      return nullptr;
+    }
+    T* objects = slab->objects();
+    if constexpr (!kConstructOnReuse) {
+      static_assert(std::is_nothrow_default_constructible_v<T>);
+      for (size_t i = 0; i < kMagazineSize; ++i) {
+        new (objects + i) T();
+      }
+    }
+    // 只增不删，不存在 ABA
+    slab->next = slabs_.load(std::memory_order_relaxed);
+    while (!slabs_.compare_exchange_weak(slab->next, slab,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+    }
+    // 倒序放入，按地址递增取出
+    for (size_t i = 0; i < kMagazineSize; ++i) {
+      magazine->objects[i] = objects + kMagazineSize - 1 - i;
+    }
+    magazine->count = kMagazineSize;
+    capacity_.fetch_add(kMagazineSize, std::memory_order_relaxed);
+    return magazine;
+  }
+
+  Cache* caches_;
+  detail::TaggedStack<Magazine> full_;
+  detail::TaggedStack<Magazine> empty_;
+  std::mutex shared_mutex_;
+  std::atomic<Slab*> slabs_{nullptr};
+  std::atomic<uint64_t> capacity_{0};
+
+  // noncopyable
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+};
+}  // namespace memory
+}  // end of namespace umu
@@ -0,0 +1,262 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "string.h"
+
+// 路径处理，只操作 string_view，结果是输入的子串，
+// 或者写入调用者提供的缓冲区（末尾写 '\0'），不分配内存。
+// '/' 和 '\' 都当作分隔符；Windows 上还识别盘符（C:）和 UNC（\\server\share）。
+// 写缓冲区的函数返回写入的长度，缓冲区不够时返回 kOverflow
+namespace umu {
+namespace path {
+constexpr size_t kOverflow = SIZE_MAX;
+
+#if defined(_WIN32)
+constexpr char kPreferredSeparator = '\\';
+#else
+constexpr char kPreferredSeparator = '/';
+#endif
+
+template <typename CharType>
+[[nodiscard]] constexpr bool IsSeparator(CharType c) noexcept {
+  return '/' == c || '\\' == c;
+}
+
+namespace detail {
+// 根的长度，例如 "/"、"C:"、"C:\"、"\\server\share\"
+template <typename CharType>
+constexpr size_t RootLength(std::basic_string_view<CharType> p) noexcept {
+#if defined(_WIN32)
+  if (2 <= p.size() && ':' == p[1] &&
+      (('a' <= p[0] && p[0] <= 'z') || ('A' <= p[0] && p[0] <= 'Z'))) {
+    return 3 <= p.size() && IsSeparator(p[2]) ? 3 : 2;
+  }
+  if (3 <= p.size() && IsSeparator(p[0]) && IsSeparator(p[1]) &&
+      !IsSeparator(p[2])) {
+    // \\server\share\，share 后面的分隔符也算在根里
+    size_t i = 2;
+    for (int part = 0; part < 2 && i < p.size(); ++part) {
+      while (i < p.size() && !IsSeparator(p[i])) {
+        ++i;
+      }
+      if (i < p.size()) {
+        ++i;
+      }
+    }
+    return i;
+  }
+#endif
+  return !p.empty() && IsSeparator(p[0]) ? 1 : 0;
+}
+
+template <typename CharType>
+constexpr size_t FileNameOffset(std::basic_string_view<CharType> p) noexcept {
+  const size_t root = RootLength(p);
+  size_t i = p.size();
+  while (root < i && !IsSeparator(p[i - 1])) {
+    --i;
+  }
+  return i;
+}
+
+template <typename CharType>
+class BufferWriter {
+ public:
+  BufferWriter(CharType* buffer, size_t capacity) noexcept
+      : buffer_(buffer), capacity_(capacity) {}
+
+  // 给 '\0' 留一个位置
+  bool Append(std::basic_string_view<CharType> s) noexcept {
+    if (capacity_ <= size_ || capacity_ - size_ <= s.size()) {
+      return false;
+    }
+    for (const CharType c : s) {
+      buffer_[size_++] = c;
+    }
+    return true;
+  }
+
+  bool Append(CharType c) noexcept {
+    return Append(std::basic_string_view<CharType>(&c, 1));
+  }
+
+  void Truncate(size_t size) noexcept { size_ = size; }
+
+  [[nodiscard]] size_t size() const noexcept { return size_; }
+  [[nodiscard]] CharType at(size_t i) const noexcept { return buffer_[i]; }
+
+  size_t Finish() noexcept {
+    if (capacity_ <= size_) {
+      return kOverflow;
+    }
+    buffer_[size_] = 0;
+    return size_;
+  }
+
+ private:
+  CharType* buffer_;
+  size_t capacity_;
+  size_t size_ = 0;
+};
+
+template <typename CharType>
+inline bool AppendRoot(BufferWriter<CharType>* writer,
+                       std::basic_string_view<CharType> root,
+                       CharType separator) noexcept {
+  for (const CharType c : root) {
+    if (!writer->Append(IsSeparator(c) ? separator : c)) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace detail
+
+// 根部分，例如 "/"、"C:\"，没有时为空
+template <class PathType>
+[[nodiscard]] constexpr auto RootName(const PathType& path) noexcept {
+  const auto p = string::detail::ToStringView(path);
+  return p.substr(0, detail::RootLength(p));
+}
+
+template <class PathType>
+[[nodiscard]] constexpr bool HasRoot(const PathType& path) noexcept {
+  return 0 < detail::RootLength(string::detail::ToStringView(path));
+}
+
+// 最后一个分隔符之后的部分，以分隔符结尾时为空
+template <class PathType>
+[[nodiscard]] constexpr auto FileName(const PathType& path) noexcept {
+  const auto p = string::detail::ToStringView(path);
+  return p.substr(detail::FileNameOffset(p));
+}
+
+// 去掉文件名和它前面的分隔符，保留根："/a/b" -> "/a"，"/a" -> "/"，"a" -> ""
+template <class PathType>
+[[nodiscard]] constexpr auto Parent(const PathType& path) noexcept {
+  const auto p = string::detail::ToStringView(path);
+  const size_t root = detail::RootLength(p);
+  size_t end = detail::FileNameOffset(p);
+  while (root < end && IsSeparator(p[end - 1])) {
+    --end;
+  }
+  return p.substr(0, end);
+}
+
+// 扩展名，带 '.'。"."、".."、".bashrc" 没有扩展名
+template <class PathType>
+[[nodiscard]] constexpr auto Extension(const PathType& path) noexcept {
+  const auto name = FileName(path);
+  const size_t dot = name.rfind('.');
+  if (decltype(name)::npos == dot || 0 == dot ||
+      (2 == name.size() && '.' == name[0])) {
+    return name.substr(name.size());
+  }
+  return name.substr(dot);
+}
+
+template <class PathType>
+[[nodiscard]] constexpr auto Stem(const PathType& path) noexcept {
+  const auto name = FileName(path);
+  return name.substr(0, name.size() - Extension(path).size());
+}
+
+// 用 separator 连接 base 和 path，path 有根时结果就是 path
+template <typename CharType, class BaseType, class PathType>
+inline size_t Join(CharType* buffer,
+                   size_t capacity,
+                   const BaseType& base,
+                   const PathType& path,
+                   CharType separator = kPreferredSeparator) noexcept {
+  const std::basic_string_view<CharType> b = string::detail::ToStringView(base);
+  const std::basic_string_view<CharType> p = string::detail::ToStringView(path);
+  detail::BufferWriter<CharType> writer(buffer, capacity);
+  if (HasRoot(p) || b.empty()) {
+    return writer.Append(p) ? writer.Finish() : kOverflow;
+  }
+  if (!writer.Append(b)) {
+    return kOverflow;
+  }
+  if (!IsSeparator(b.back()) && !p.empty() && !IsSeparator(p.front()) &&
+      !writer.Append(separator)) {
+    return kOverflow;
+  }
+  return writer.Append(p) ? writer.Finish() : kOverflow;
+}
+
+template <typename CharType, size_t N, class BaseType, class PathType>
+inline size_t Join(CharType (&buffer)[N],
+                   const BaseType& base,
+                   const PathType& path,
+                   CharType separator = kPreferredSeparator) noexcept {
+  return Join(buffer, N, base, path, separator);
+}
+
+// 规范化：分隔符统一为 separator，合并重复分隔符，去掉 "."，
+// ".." 抵消前一级（根之上的 ".." 丢弃，相对路径开头的 ".." 保留），
+// 去掉末尾分隔符，结果为空时是 "."。只做字符串处理，不访问文件系统
+template <typename CharType, class PathType>
+inline size_t Normalize(CharType* buffer,
+                        size_t capacity,
+                        const PathType& path,
+                        CharType separator = kPreferredSeparator) noexcept {
+  const std::basic_string_view<CharType> p = string::detail::ToStringView(path);
+  detail::BufferWriter<CharType> writer(buffer, capacity);
+  const size_t root = detail::RootLength(p);
+  if (!detail::AppendRoot(&writer, p.substr(0, root), separator)) {
+    return kOverflow;
+  }
+  const size_t base = writer.size();
+  // 可以被 ".." 抵消的级数
+  size_t depth = 0;
+  for (size_t i = root; i < p.size();) {
+    while (i < p.size() && IsSeparator(p[i])) {
+      ++i;
+    }
+    size_t end = i;
+    while (end < p.size() && !IsSeparator(p[end])) {
+      ++end;
+    }
+    const auto component = p.substr(i, end - i);
+    i = end;
+    if (component.empty() || (1 == component.size() && '.' == component[0])) {
+      continue;
+    }
+    if (2 == component.size() && '.' == component[0] && '.' == component[1]) {
+      if (0 < depth) {
+        size_t size = writer.size();
+        while (base < size && separator != writer.at(size - 1)) {
+          --size;
+        }
+        writer.Truncate(base < size ? size - 1 : base);
+        --depth;
+        continue;
+      }
+      if (0 < root) {
+        continue;
+      }
+    } else {
+      ++depth;
+    }
+    if ((base < writer.size() && !writer.Append(separator)) ||
+        !writer.Append(component)) {
+      return kOverflow;
+    }
+  }
+  if (0 == writer.size() && !writer.Append(CharType('.'))) {
+    return kOverflow;
+  }
+  return writer.Finish();
+}
+
+template <typename CharType, size_t N, class PathType>
+inline size_t Normalize(CharType (&buffer)[N],
+                        const PathType& path,
+                        CharType separator = kPreferredSeparator) noexcept {
+  return Normalize(buffer, N, path, separator);
+}
+}  // namespace path
+}  // end of namespace umu
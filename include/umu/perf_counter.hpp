@@ -0,0 +1,226 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+// 硬件性能计数器，TimeMeasure 的计数版本（只支持 Linux）：
+//   static thread_local umu::PerfCounterGroup group;
+//   umu::PerfCounts counts;
+//   {
+//     umu::PerfCounterScope scope(group, counts);
+//     ...
+//   }
+//   counts.Get(umu::PerfEvent::kCacheMisses)
+// 计数器属于创建它的线程，只统计用户态。容器里没有权限
+// （perf_event_paranoid、seccomp）或者虚拟机不支持某个事件时，
+// 该事件被跳过，全部失败时 available() 为 false，scope 什么也不做
+namespace umu {
+enum class PerfEvent {
+  kCycles,
+  kInstructions,
+  kCacheMisses,
+  kBranchMisses,
+  kContextSwitches,
+  kCount
+};
+
+struct PerfCounts {
+  static constexpr size_t kCount = static_cast<size_t>(PerfEvent::kCount);
+
+  [[nodiscard]] bool Has(PerfEvent event) const noexcept {
+    return valid[static_cast<size_t>(event)];
+  }
+
+  // 不可用的事件返回 0
+  [[nodiscard]] uint64_t Get(PerfEvent event) const noexcept {
+    return values[static_cast<size_t>(event)];
+  }
+
+  // instructions per cycle，缺少任一计数时返回 0
+  [[nodiscard]] double Ipc() const noexcept {
+    if (!Has(PerfEvent::kCycles) || !Has(PerfEvent::kInstructions) ||
+        0 == Get(PerfEvent::kCycles)) {
+      return 0;
+    }
+    return static_cast<double>(Get(PerfEvent::kInstructions)) /
+           static_cast<double>(Get(PerfEvent::kCycles));
+  }
+
+  uint64_t values[kCount]{};
+  bool valid[kCount]{};
+};
+
+class PerfCounterGroup {
+ public:
+  PerfCounterGroup() noexcept {
+#if defined(__linux__)
+    for (size_t i = 0; i < PerfCounts::kCount; ++i) {
+      fds_[i] = -1;
+    }
+    for (size_t i = 0; i < PerfCounts::kCount; ++i) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = kEvents[i].type;
+      attr.config = kEvents[i].config;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                         PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      // 第一个打开成功的事件做组长，其余跟随组长一起调度
+      const int fd = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, leader_, PERF_FLAG_FD_CLOEXEC));
+      if (fd < 0) {
+        continue;
+      }
+      uint64_t id;
+      if (ioctl(fd, PERF_EVENT_IOC_ID, &id) < 0) {
+        close(fd);
+        continue;
+      }
+      fds_[i] = fd;
+      ids_[i] = id;
+      ++count_;
+      if (leader_ < 0) {
+        leader_ = fd;
+      }
+    }
+#endif
+  }
+
+  ~PerfCounterGroup() {
+#if defined(__linux__)
+    // 先关组员，最后关组长
+    for (size_t i = PerfCounts::kCount; 0 < i--;) {
+      if (0 <= fds_[i] && fds_[i] != leader_) {
+        close(fds_[i]);
+      }
+    }
+    if (0 <= leader_) {
+      close(leader_);
+    }
+#endif
+  }
+
+  [[nodiscard]] bool available() const noexcept { return 0 < count_; }
+
+  [[nodiscard]] bool Has(PerfEvent event) const noexcept {
+#if defined(__linux__)
+    return 0 <= fds_[static_cast<size_t>(event)];
+#else
+    (void)event;
+    return false;
+#endif
+  }
+
+  // 读取自创建以来的累计值。计数器被分时复用时按 enabled/running 放大
+  bool Read(PerfCounts* counts) const noexcept {
+    *counts = PerfCounts();
+#if defined(__linux__)
+    if (leader_ < 0) {
+      return false;
+    }
+    // nr, time_enabled, time_running, {value, id} * nr
+    uint64_t data[3 + 2 * PerfCounts::kCount];
+    const ssize_t size = read(leader_, data, sizeof(data));
+    if (size < static_cast<ssize_t>(3 * sizeof(uint64_t))) {
+      return false;
+    }
+    const uint64_t nr = data[0];
+    const uint64_t enabled = data[1];
+    const uint64_t running = data[2];
+    if (0 == running) {
+      return false;
+    }
+    for (uint64_t n = 0; n < nr && n < PerfCounts::kCount; ++n) {
+      const uint64_t value = data[3 + 2 * n];
+      const uint64_t id = data[4 + 2 * n];
+      for (size_t i = 0; i < PerfCounts::kCount; ++i) {
+        if (0 <= fds_[i] && ids_[i] == id) {
+          counts->values[i] =
+              enabled == running
+                  ? value
+                  : static_cast<uint64_t>(static_cast<double>(value) *
+                                          static_cast<double>(enabled) /
+                                          static_cast<double>(running));
+          counts->valid[i] = true;
+        }
+      }
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+ private:
+#if defined(__linux__)
+  struct EventConfig {
+    uint32_t type;
+    uint64_t config;
+  };
+
+  // 顺序与 PerfEvent 一致
+  static constexpr EventConfig kEvents[] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+  };
+  static_assert(sizeof(kEvents) / sizeof(kEvents[0]) == PerfCounts::kCount);
+
+  int fds_[PerfCounts::kCount];
+  uint64_t ids_[PerfCounts::kCount]{};
+  int leader_ = -1;
+#endif
+  size_t count_ = 0;
+
+  // noncopyable
+  PerfCounterGroup(const PerfCounterGroup&) = delete;
+  PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+};
+
+// 析构时把作用域内的计数增量写入 result，group 不可用时 result 全部无效
+class PerfCounterScope {
+ public:
+  PerfCounterScope(const PerfCounterGroup& group, PerfCounts& result) noexcept
+      : group_(group), save_(result) {
+    started_ = group_.Read(&start_);
+  }
+
+  ~PerfCounterScope() {
+    PerfCounts end;
+    if (!started_ || !group_.Read(&end)) {
+      save_ = PerfCounts();
+      return;
+    }
+    for (size_t i = 0; i < PerfCounts::kCount; ++i) {
+      end.valid[i] = end.valid[i] && start_.valid[i];
+      end.values[i] = end.valid[i] && end.values[i] >= start_.values[i]
+                          ? end.values[i] - start_.values[i]
+                          : 0;
+    }
+    save_ = end;
+  }
+
+ private:
+  const PerfCounterGroup& group_;
+  PerfCounts& save_;
+  PerfCounts start_;
+  bool started_;
+
+  PerfCounterScope(const PerfCounterScope&) = delete;
+  PerfCounterScope& operator=(const PerfCounterScope&) = delete;
+};
+}  // namespace umu
@@ -0,0 +1,388 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "time_measure.hpp"
+
+// 进程内的层次化计时：
+//   void Handle() {
+//     UMU_PROFILE_SCOPE("Handle");
+//     { UMU_PROFILE_SCOPE("Parse"); ... }
+//   }
+//   umu::Profiler::Instance().WriteChromeTrace("trace.json");
+// 每个线程写自己的环形缓冲，不加锁；作用域结束时记一条完整事件（开始 + 时长），
+// 比分别记 begin/end 少一半写入。缓冲满了覆盖最旧的事件，导出时计入 dropped。
+// 线程第一次记录事件时分配缓冲，每个事件 40 字节，默认 65536 个事件，
+// 即每个线程约 2.5 MB；线程多时先用 SetThreadCapacity 调小。
+// name 只保存指针，必须是字符串字面量或者在导出前一直有效。
+// 定义 UMU_DISABLE_PROFILER 时宏展开为空
+namespace umu {
+struct ProfileRecord {
+  const char* name;
+  uint32_t thread;
+  // 嵌套深度，最外层为 0
+  uint32_t depth;
+  // 相对 Profiler 创建时刻
+  uint64_t begin_ns;
+  uint64_t duration_ns;
+};
+
+class Profiler {
+ public:
+#if UMU_HAS_TSC
+  using Clock = TscClock<false>;
+#else
+  using Clock = SystemClock;
+#endif
+  // 每个线程缓冲的默认事件数
+  static constexpr size_t kDefaultThreadCapacity = 1 << 16;
+
+  static Profiler& Instance() {
+    static Profiler profiler;
+    return profiler;
+  }
+
+  void SetEnabled(bool enabled) noexcept {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] bool enabled() const noexcept {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // 导出时作为线程名
+  void SetThreadName(std::string name) {
+    ThreadBuffer* buffer = CurrentThread().buffer.get();
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer->name = std::move(name);
+  }
+
+  // 之后第一次记录事件的线程按这个事件数分配缓冲，向上取 2 的幂，
+  // 已有缓冲的线程不受影响
+  void SetThreadCapacity(size_t capacity) {
+    size_t rounded = 2;
+    while (rounded < capacity) {
+      rounded *= 2;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_capacity_ = rounded;
+  }
+
+  // 被覆盖而没能导出的事件数
+  [[nodiscard]] uint64_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // 取出所有线程已结束的事件并从缓冲中移除，按开始时间排序，返回条数
+  size_t Collect(std::vector<ProfileRecord>* records) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return CollectLocked(records);
+  }
+
+  // Chrome/Perfetto 的 JSON trace 格式，用 chrome://tracing 或
+  // ui.perfetto.dev 打开
+  bool WriteChromeTrace(const char* path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 先打开文件，打不开时不取走缓冲里的事件
+    std::FILE* file = std::fopen(path, "wb");
+    if (nullptr == file) {
+      return false;
+    }
+    std::string json;
+    json.append("{\"traceEvents\":[\n");
+    bool first = true;
+    // 已退出线程的缓冲在 CollectLocked 中释放，先输出线程名
+    for (const auto& buffer : buffers_) {
+      if (!buffer->name.empty()) {
+        AppendSeparator(&json, &first);
+        json.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":")
+            .append(std::to_string(buffer->thread))
+            .append(",\"args\":{\"name\":");
+        AppendJsonString(&json, buffer->name);
+        json.append("}}");
+      }
+    }
+    std::vector<ProfileRecord> records;
+    CollectLocked(&records);
+    json.reserve(json.size() + records.size() * 96);
+    char number[64];
+    for (const auto& record : records) {
+      AppendSeparator(&json, &first);
+      json.append("{\"name\":");
+      AppendJsonString(&json, record.name);
+      std::snprintf(number, sizeof(number),
+                    ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,"
+                    "\"dur\":%.3f}",
+                    record.thread, record.begin_ns / 1000.0,
+                    record.duration_ns / 1000.0);
+      json.append(number);
+    }
+    json.append("\n]}\n");
+    const bool written =
+        json.size() == std::fwrite(json.data(), 1, json.size(), file);
+    return 0 == std::fclose(file) && written;
+  }
+
+  // 紧凑的二进制格式，小端：
+  //   "UMUPROF1"
+  //   uint32 名字个数，每个名字 uint32 长度 + 字节
+  //   uint64 事件个数，每个事件
+  //     uint32 名字下标、uint32 线程、uint32 深度、uint64 开始、uint64 时长
+  bool WriteBinary(const char* path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::FILE* file = std::fopen(path, "wb");
+    if (nullptr == file) {
+      return false;
+    }
+    std::vector<ProfileRecord> records;
+    CollectLocked(&records);
+
+    std::unordered_map<const char*, uint32_t> name_index;
+    std::string names;
+    for (const auto& record : records) {
+      if (name_index
+              .emplace(record.name, static_cast<uint32_t>(name_index.size()))
+              .second) {
+        const std::string_view name(record.name);
+        AppendPod(&names, static_cast<uint32_t>(name.size()));
+        names.append(name);
+      }
+    }
+
+    std::string data("UMUPROF1");
+    AppendPod(&data, static_cast<uint32_t>(name_index.size()));
+    data.append(names);
+    AppendPod(&data, static_cast<uint64_t>(records.size()));
+    for (const auto& record : records) {
+      AppendPod(&data, name_index[record.name]);
+      AppendPod(&data, record.thread);
+      AppendPod(&data, record.depth);
+      AppendPod(&data, record.begin_ns);
+      AppendPod(&data, record.duration_ns);
+    }
+
+    const bool written =
+        data.size() == std::fwrite(data.data(), 1, data.size(), file);
+    return 0 == std::fclose(file) && written;
+  }
+
+  // 由 ProfileScope 调用
+  void Record(const char* name,
+              uint64_t begin,
+              uint64_t end,
+              uint32_t depth) noexcept {
+    CurrentThread().buffer->Push(name, begin, end, depth);
+  }
+
+  static uint32_t& Depth() noexcept {
+    static thread_local uint32_t depth = 0;
+    return depth;
+  }
+
+ private:
+  // 每个槽位是一个 seqlock：写之前 sequence 置为奇数，写完置为偶数，
+  // 导出线程读前后 sequence 不变且等于期望值才算有效
+  struct Event {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> begin{0};
+    std::atomic<uint64_t> end{0};
+    std::atomic<uint32_t> depth{0};
+  };
+
+  struct ThreadBuffer {
+    ThreadBuffer(uint32_t thread_id, size_t event_capacity)
+        : events(new Event[event_capacity]),
+          capacity(event_capacity),
+          thread(thread_id) {}
+
+    // 只有所属线程调用
+    void Push(const char* event_name,
+              uint64_t begin_time,
+              uint64_t end_time,
+              uint32_t event_depth) noexcept {
+      const uint64_t index = head.load(std::memory_order_relaxed);
+      Event& event = events[index & (capacity - 1)];
+      event.sequence.store(2 * index + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      event.name.store(event_name, std::memory_order_relaxed);
+      event.begin.store(begin_time, std::memory_order_relaxed);
+      event.end.store(end_time, std::memory_order_relaxed);
+      event.depth.store(event_depth, std::memory_order_relaxed);
+      event.sequence.store(2 * index + 2, std::memory_order_release);
+      head.store(index + 1, std::memory_order_release);
+    }
+
+    std::unique_ptr<Event[]> events;
+    // 2 的幂
+    const size_t capacity;
+    // 已写入的事件总数
+    std::atomic<uint64_t> head{0};
+    // 以下由 Profiler::mutex_ 保护
+    uint64_t tail = 0;
+    uint32_t thread;
+    std::string name;
+    std::atomic<bool> exited{false};
+  };
+
+  // 线程退出时标记缓冲，导出后由 Profiler 释放
+  struct ThreadState {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadState() {
+      if (buffer) {
+        buffer->exited.store(true, std::memory_order_release);
+      }
+    }
+  };
+
+  Profiler() : epoch_(Clock::Start()) {}
+
+  ThreadState& CurrentThread() {
+    static thread_local ThreadState state;
+    if (!state.buffer) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      state.buffer = std::make_shared<ThreadBuffer>(next_thread_++, thread_capacity_);
+      buffers_.push_back(state.buffer);
+    }
+    return state;
+  }
+
+  size_t CollectLocked(std::vector<ProfileRecord>* records) {
+    const size_t old_size = records->size();
+    for (auto& buffer : buffers_) {
+      // 先看是否已退出，之后读到的 head 一定包含它的全部事件
+      const bool exited = buffer->exited.load(std::memory_order_acquire);
+      const uint64_t head = buffer->head.load(std::memory_order_acquire);
+      const uint64_t capacity = buffer->capacity;
+      uint64_t index = buffer->tail;
+      if (head - index > capacity) {
+        dropped_.fetch_add(head - capacity - index, std::memory_order_relaxed);
+        index = head - capacity;
+      }
+      for (; index < head; ++index) {
+        Event& event = buffer->events[index & (capacity - 1)];
+        const uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+        const char* name = event.name.load(std::memory_order_relaxed);
+        const uint64_t begin = event.begin.load(std::memory_order_relaxed);
+        const uint64_t end = event.end.load(std::memory_order_relaxed);
+        const uint32_t depth = event.depth.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (2 * index + 2 != sequence ||
+            sequence != event.sequence.load(std::memory_order_relaxed)) {
+          // 读的过程中被覆盖
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        records->push_back({name, buffer->thread, depth,
+                            Clock::ToNanoseconds(begin - epoch_),
+                            Clock::ToNanoseconds(end - begin)});
+      }
+      buffer->tail = head;
+      if (exited) {
+        buffer.reset();
+      }
+    }
+    buffers_.erase(std::remove(buffers_.begin(), buffers_.end(), nullptr),
+                   buffers_.end());
+    std::sort(records->begin() + old_size, records->end(),
+              [](const ProfileRecord& a, const ProfileRecord& b) {
+                return a.begin_ns < b.begin_ns ||
+                       (a.begin_ns == b.begin_ns && a.depth < b.depth);
+              });
+    return records->size() - old_size;
+  }
+
+  static void AppendSeparator(std::string* json, bool* first) {
+    if (*first) {
+      *first = false;
+    } else {
+      json->append(",\n");
+    }
+  }
+
+  static void AppendJsonString(std::string* json, std::string_view s) {
+    json->push_back('"');
+    for (const char c : s) {
+      if ('"' == c || '\\' == c) {
+        json->push_back('\\');
+        json->push_back(c);
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        json->append(escaped);
+      } else {
+        json->push_back(c);
+      }
+    }
+    json->push_back('"');
+  }
+
+  template <typename T>
+  static void AppendPod(std::string* data, T value) {
+    char bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    data->append(bytes, sizeof(T));
+  }
+
+  std::atomic<bool> enabled_{true};
+  std::atomic<uint64_t> dropped_{0};
+  const uint64_t epoch_;
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+  uint32_t next_thread_ = 1;
+  size_t thread_capacity_ = kDefaultThreadCapacity;
+
+  // noncopyable
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+};
+
+class ProfileScope {
+ public:
+  explicit ProfileScope(const char* name) noexcept
+      : name_(Profiler::Instance().enabled() ? name : nullptr) {
+    if (nullptr != name_) {
+      depth_ = Profiler::Depth()++;
+      begin_ = Profiler::Clock::Start();
+    }
+  }
+
+  ~ProfileScope() {
+    if (nullptr != name_) {
+      const uint64_t end = Profiler::Clock::Stop();
+      --Profiler::Depth();
+      Profiler::Instance().Record(name_, begin_, end, depth_);
+    }
+  }
+
+ private:
+  const char* name_;
+  uint32_t depth_ = 0;
+  uint64_t begin_ = 0;
+
+  // noncopyable
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+};
+}  // namespace umu
+
+#define UMU_PROFILE_LINENAME_CAT(name, line) name##line
+#define UMU_PROFILE_LINENAME(name, line) UMU_PROFILE_LINENAME_CAT(name, line)
+#if defined(UMU_DISABLE_PROFILER)
+#define UMU_PROFILE_SCOPE(name)
+#else
+#define UMU_PROFILE_SCOPE(name) \
+  umu::ProfileScope UMU_PROFILE_LINENAME(PROFILE, __LINE__)(name)
+#endif
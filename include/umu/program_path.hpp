@@ -0,0 +1,149 @@
+﻿#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <tchar.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "path.h"
+#include "string.h"
+
+// 程序路径解析，结果只算一次：
+//   const auto& paths = umu::apppath::ProgramPaths::Current();
+//   paths.directory()          // C:\Product\bin\        /opt/product/bin/
+//   paths.base_name()          // app.exe                app
+//   paths.product_directory()  // C:\Product\            /opt/product/
+// 四个 view 都指向同一个字符串，目录以分隔符结尾。
+// 产品目录：路径中最后一个 bin 目录（不区分大小写）的上一级，
+// 没有 bin 时是程序所在目录的上一级
+namespace umu::apppath {
+#if defined(_WIN32)
+using PathChar = TCHAR;
+constexpr PathChar kPathSeparator = _T('\\');
+#else
+using PathChar = char;
+constexpr PathChar kPathSeparator = '/';
+#endif
+
+class ProgramPaths {
+ public:
+  using string_type = std::basic_string<PathChar>;
+  using view_type = std::basic_string_view<PathChar>;
+
+  // 当前进程的主程序，首次调用时解析，线程安全
+  static const ProgramPaths& Current() {
+    static const ProgramPaths paths(ResolveProgramPath());
+    return paths;
+  }
+
+#if defined(_WIN32)
+  // 指定模块（例如 DLL 自身），每次构造都会调用 GetModuleFileName
+  explicit ProgramPaths(HMODULE module_handle)
+      : ProgramPaths(ResolveModulePath(module_handle)) {}
+#endif
+
+  explicit ProgramPaths(string_type path) : path_(std::move(path)) {
+    directory_size_ = path_.size() - umu::path::FileName(path_).size();
+    product_directory_size_ = ProductDirectorySize(directory());
+  }
+
+  // 解析失败时所有 view 都为空
+  [[nodiscard]] bool valid() const noexcept { return !path_.empty(); }
+
+  [[nodiscard]] view_type path() const noexcept { return path_; }
+
+  [[nodiscard]] view_type directory() const noexcept {
+    return view_type(path_.data(), directory_size_);
+  }
+
+  [[nodiscard]] view_type base_name() const noexcept {
+    return view_type(path_.data() + directory_size_,
+                     path_.size() - directory_size_);
+  }
+
+  [[nodiscard]] view_type product_directory() const noexcept {
+    return view_type(path_.data(), product_directory_size_);
+  }
+
+  // directory 中产品目录部分的长度
+  static size_t ProductDirectorySize(view_type directory) noexcept {
+    if (directory.empty()) {
+      return 0;
+    }
+    constexpr PathChar bin[] = {kPathSeparator, 'b', 'i', 'n', kPathSeparator};
+    const size_t found =
+        string::IRFind(directory, view_type(bin, sizeof(bin) / sizeof(*bin)));
+    if (view_type::npos != found) {
+      return found + 1;
+    }
+    // 上一级目录，已经是根目录时不变
+    if (directory.size() < 2) {
+      return directory.size();
+    }
+    const size_t parent =
+        directory.rfind(kPathSeparator, directory.size() - 2);
+    return view_type::npos == parent ? directory.size() : parent + 1;
+  }
+
+ private:
+#if defined(_WIN32)
+  static string_type ResolveModulePath(HMODULE module_handle) {
+    string_type path;
+    // 按两倍增长，长路径（\\?\ 前缀，最长 32767）也只需要几次
+    for (DWORD buffer_size = MAX_PATH;; buffer_size *= 2) {
+      path.resize(buffer_size);
+      const DWORD size =
+          ::GetModuleFileName(module_handle, path.data(), buffer_size);
+      if (0 == size) {
+        return string_type();
+      }
+      if (size < buffer_size) {
+        path.resize(size);
+        return path;
+      }
+      if (ERROR_INSUFFICIENT_BUFFER != ::GetLastError() &&
+          ERROR_SUCCESS != ::GetLastError()) {
+        return string_type();
+      }
+    }
+  }
+
+  static string_type ResolveProgramPath() { return ResolveModulePath(nullptr); }
+#else
+  // readlink 不写 '\0'，返回值等于缓冲区大小时可能被截断，加倍重试
+  static string_type ResolveProgramPath() {
+    string_type path;
+    for (size_t buffer_size = 256; buffer_size <= 65536; buffer_size *= 2) {
+      path.resize(buffer_size);
+      const ssize_t size =
+          readlink("/proc/self/exe", path.data(), buffer_size);
+      if (size < 0) {
+        return string_type();
+      }
+      if (static_cast<size_t>(size) < buffer_size) {
+        path.resize(static_cast<size_t>(size));
+        // 程序文件被替换或删除后内核会加上这个后缀
+        constexpr std::string_view kDeleted = " (deleted)";
+        if (kDeleted.size() < path.size() &&
+            0 == path.compare(path.size() - kDeleted.size(), kDeleted.size(),
+                              kDeleted.data())) {
+          path.resize(path.size() - kDeleted.size());
+        }
+        return path;
+      }
+    }
+    return string_type();
+  }
+#endif
+
+  string_type path_;
+  size_t directory_size_;
+  size_t product_directory_size_;
+};
+}  // namespace umu::apppath
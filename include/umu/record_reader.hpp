@@ -0,0 +1,343 @@
+﻿#pragma once
+
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "simd.h"
+
+namespace umu {
+namespace string {
+struct RecordFormat {
+  char separator = ',';
+  // '\0' 表示不识别引号
+  char quote = '"';
+  // '\0' 表示没有转义字符；转义字符后面的一个字符按原样保留
+  char escape = '\0';
+};
+
+inline constexpr RecordFormat kCsvFormat{',', '"', '\0'};
+inline constexpr RecordFormat kTsvFormat{'\t', '\0', '\\'};
+
+// 流式读取 CSV/TSV 记录，按块喂数据，记录可以跨块：
+//   RecordReader reader;
+//   while (ReadChunk(&chunk)) {
+//     reader.Feed(chunk);
+//     while (reader.Next()) { reader.Field<int64_t>(0); ... }
+//   }
+//   reader.Finish();
+//   while (reader.Next()) { ... }
+// 引号内两个 quote 表示一个 quote，字段中间出现的 quote 按普通字符处理。
+// 字段是 chunk 的 view，只有跨块的记录和含转义的字段才拷贝到内部缓冲，
+// 缓冲反复使用，稳定后每条记录不再分配内存。
+// 字段在下一次 Next/Feed 之前有效；chunk 在取完其中的记录之前必须有效
+class RecordReader {
+ public:
+  static constexpr size_t npos = std::string_view::npos;
+
+  explicit RecordReader(const RecordFormat& format = kCsvFormat) noexcept
+      : format_(format) {
+    size_t record_count = 0;
+    size_t quoted_count = 0;
+    size_t field_count = 0;
+    record_chars_[record_count++] = '\n';
+    record_chars_[record_count++] = format.separator;
+    field_chars_[field_count++] = format.separator;
+    if ('\0' != format.quote) {
+      record_chars_[record_count++] = format.quote;
+      quoted_chars_[quoted_count++] = format.quote;
+    }
+    if ('\0' != format.escape) {
+      record_chars_[record_count++] = format.escape;
+      quoted_chars_[quoted_count++] = format.escape;
+      field_chars_[field_count++] = format.escape;
+    }
+    record_set_ = simd::CharSet<char>({record_chars_, record_count});
+    quoted_set_ = simd::CharSet<char>({quoted_chars_, quoted_count});
+    field_set_ = simd::CharSet<char>({field_chars_, field_count});
+  }
+
+  // 调用前应该已经用 Next 取完上一块中的记录
+  void Feed(std::string_view chunk) {
+    ReleasePending();
+    data_ = chunk;
+    position_ = 0;
+    if (pending_.empty()) {
+      return;
+    }
+    const size_t end = FindRecordEnd(chunk, 0, &pending_state_);
+    if (npos == end) {
+      pending_.append(chunk);
+      position_ = chunk.size();
+      return;
+    }
+    pending_.append(chunk.data(), end);
+    pending_ready_ = true;
+    position_ = end + 1;
+  }
+
+  // 输入结束，最后一条没有换行的记录也可以被 Next 取到
+  void Finish() noexcept {
+    finished_ = true;
+    if (!pending_.empty()) {
+      pending_ready_ = true;
+    }
+  }
+
+  // 解析下一条完整的记录，需要更多数据时返回 false
+  bool Next() {
+    ReleasePending();
+    if (pending_ready_) {
+      pending_ready_ = false;
+      release_pending_ = true;
+      ParseRecord(pending_);
+      return true;
+    }
+    if (position_ < data_.size()) {
+      ScanState state;
+      const size_t end = FindRecordEnd(data_, position_, &state);
+      if (npos != end) {
+        const std::string_view record = data_.substr(position_, end - position_);
+        position_ = end + 1;
+        ParseRecord(record);
+        return true;
+      }
+      pending_.assign(data_.data() + position_, data_.size() - position_);
+      pending_state_ = state;
+      position_ = data_.size();
+      if (finished_) {
+        release_pending_ = true;
+        ParseRecord(pending_);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  [[nodiscard]] size_t size() const noexcept { return fields_.size(); }
+
+  [[nodiscard]] const std::vector<std::string_view>& fields() const noexcept {
+    return fields_;
+  }
+
+  [[nodiscard]] std::string_view operator[](size_t i) const noexcept {
+    return fields_[i];
+  }
+
+  // 越界返回空
+  [[nodiscard]] std::string_view Field(size_t i) const noexcept {
+    return i < fields_.size() ? fields_[i] : std::string_view();
+  }
+
+  // 用 from_chars 转换，越界、格式错误或有多余字符时返回 std::nullopt
+  template <typename T>
+  [[nodiscard]] std::optional<T> Field(size_t i) const noexcept {
+    if (i >= fields_.size()) {
+      return std::nullopt;
+    }
+    const std::string_view field = fields_[i];
+    const char* const last = field.data() + field.size();
+    T value{};
+    const auto [end, error] = std::from_chars(field.data(), last, value);
+    if (std::errc() != error || last != end) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+ private:
+  // 跨块扫描时带着走的状态
+  struct ScanState {
+    bool in_quotes = false;
+    // 引号内遇到 quote，要看下一个字符才知道是结束还是转义
+    bool quote_in_quotes = false;
+    bool escaped = false;
+    // 下一个字符是字段开头
+    bool field_start = true;
+  };
+
+  // 字段值：data 为 nullptr 时在 scratch_ 的 offset 处
+  struct Span {
+    const char* data;
+    size_t offset;
+    size_t size;
+  };
+
+  void ReleasePending() noexcept {
+    if (release_pending_) {
+      release_pending_ = false;
+      pending_.clear();
+      pending_state_ = {};
+    }
+  }
+
+  // 从 pos 开始找引号外的 '\n'
+  size_t FindRecordEnd(std::string_view data,
+                       size_t pos,
+                       ScanState* state) const noexcept {
+    while (pos < data.size()) {
+      if (state->escaped) {
+        state->escaped = false;
+        state->field_start = false;
+        ++pos;
+        continue;
+      }
+      if (state->quote_in_quotes) {
+        state->quote_in_quotes = false;
+        if (format_.quote == data[pos]) {
+          ++pos;
+          continue;
+        }
+        state->in_quotes = false;
+      }
+
+      const size_t found = simd::FindFirstOf(
+          data, state->in_quotes ? quoted_set_ : record_set_, pos);
+      if (npos == found) {
+        if (pos < data.size()) {
+          state->field_start = false;
+        }
+        return npos;
+      }
+      if (found > pos) {
+        state->field_start = false;
+      }
+      pos = found + 1;
+
+      const char c = data[found];
+      if (format_.escape == c) {
+        state->escaped = true;
+      } else if (state->in_quotes) {
+        state->quote_in_quotes = true;
+      } else if ('\n' == c) {
+        return found;
+      } else if (format_.separator == c) {
+        state->field_start = true;
+      } else {
+        state->in_quotes = state->field_start;
+        state->field_start = false;
+      }
+    }
+    return npos;
+  }
+
+  void ParseRecord(std::string_view record) {
+    if (!record.empty() && '\r' == record.back()) {
+      record.remove_suffix(1);
+    }
+    spans_.clear();
+    scratch_.clear();
+    size_t pos = 0;
+    do {
+      pos = ParseField(record, pos);
+    } while (npos != pos);
+
+    fields_.clear();
+    for (const auto& span : spans_) {
+      fields_.emplace_back(
+          nullptr == span.data ? scratch_.data() + span.offset : span.data,
+          span.size);
+    }
+  }
+
+  // 返回下一个字段的起点，记录结束时返回 npos
+  size_t ParseField(std::string_view record, size_t pos) {
+    const size_t scratch_offset = scratch_.size();
+    // 只有一段时字段直接指向 record，出现第二段才拷贝到 scratch_
+    bool copied = false;
+    size_t first_begin = npos;
+    size_t first_end = npos;
+    const auto add_segment = [&](size_t begin, size_t end) {
+      if (begin >= end) {
+        return;
+      }
+      if (!copied) {
+        if (npos == first_begin) {
+          first_begin = begin;
+          first_end = end;
+          return;
+        }
+        scratch_.append(record, first_begin, first_end - first_begin);
+        copied = true;
+      }
+      scratch_.append(record, begin, end - begin);
+    };
+
+    bool in_quotes = false;
+    if ('\0' != format_.quote && pos < record.size() &&
+        format_.quote == record[pos]) {
+      in_quotes = true;
+      ++pos;
+    }
+    size_t segment = pos;
+    size_t next;
+    for (;;) {
+      const size_t found =
+          simd::FindFirstOf(record, in_quotes ? quoted_set_ : field_set_, pos);
+      if (npos == found) {
+        add_segment(segment, record.size());
+        next = npos;
+        break;
+      }
+      const char c = record[found];
+      if (format_.escape == c) {
+        add_segment(segment, found);
+        segment = found + 1;
+        pos = found + 2;
+      } else if (in_quotes) {
+        if (found + 1 < record.size() && format_.quote == record[found + 1]) {
+          add_segment(segment, found + 1);
+        } else {
+          add_segment(segment, found);
+          in_quotes = false;
+        }
+        segment = found + 1 + (in_quotes ? 1 : 0);
+        pos = segment;
+      } else {
+        add_segment(segment, found);
+        next = found + 1;
+        break;
+      }
+    }
+
+    if (copied) {
+      spans_.push_back({nullptr, scratch_offset, scratch_.size() - scratch_offset});
+    } else if (npos == first_begin) {
+      spans_.push_back({record.data(), 0, 0});
+    } else {
+      spans_.push_back({record.data() + first_begin, 0, first_end - first_begin});
+    }
+    return next;
+  }
+
+  RecordFormat format_;
+  char record_chars_[4]{};
+  char quoted_chars_[2]{};
+  char field_chars_[2]{};
+  simd::CharSet<char> record_set_;
+  simd::CharSet<char> quoted_set_;
+  simd::CharSet<char> field_set_;
+
+  std::string_view data_;
+  size_t position_ = 0;
+  // 跨块的不完整记录
+  std::string pending_;
+  ScanState pending_state_;
+  bool pending_ready_ = false;
+  // 上一条记录来自 pending_，下次 Next/Feed 时清空
+  bool release_pending_ = false;
+  bool finished_ = false;
+
+  std::string scratch_;
+  std::vector<Span> spans_;
+  std::vector<std::string_view> fields_;
+
+  // CharSet 指向本对象的成员数组
+  RecordReader(const RecordReader&) = delete;
+  RecordReader& operator=(const RecordReader&) = delete;
+};
+}  // end of namespace string
+}  // end of namespace umu
@@ -0,0 +1,192 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace umu {
+namespace string {
+// Aho-Corasick 多关键字替换，构造后只读，可以跨调用、跨线程复用。
+// 同一起点取最长关键字，命中之后从其末尾继续，不会重叠替换。
+// 按字节建表（宽字符按 code unit 的字节），字节先压缩成等价类，
+// 只有关键字里出现过的字节各占一列
+template <typename CharType>
+class ReplaceAutomaton {
+ public:
+  using view_type = std::basic_string_view<CharType>;
+  using pair_type = std::pair<view_type, view_type>;
+
+  ReplaceAutomaton() { Build(std::initializer_list<pair_type>{}); }
+
+  explicit ReplaceAutomaton(std::initializer_list<pair_type> table) {
+    Build(table);
+  }
+
+  // table 中每个元素可以转换为 std::pair<view_type, view_type>
+  template <class Table,
+            class = std::enable_if_t<
+                !std::is_same_v<std::decay_t<Table>, ReplaceAutomaton>>>
+  explicit ReplaceAutomaton(const Table& table) {
+    Build(table);
+  }
+
+  [[nodiscard]] size_t size() const noexcept { return replacements_.size(); }
+
+  // result 只在有替换时写入，返回替换次数
+  template <class StringType>
+  size_t Replace(view_type source, StringType* result) const {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(source.data());
+    const size_t byte_size = source.size() * sizeof(CharType);
+    size_t replace_times = 0;
+    size_t copied = 0;
+    size_t i = 0;
+    uint32_t state = 0;
+    bool found = false;
+    size_t found_start = 0;
+    size_t found_length = 0;
+    uint32_t found_index = 0;
+
+    for (;;) {
+      while (i < byte_size) {
+        state = next_[state * class_count_ + byte_class_[bytes[i]]];
+        ++i;
+        // 宽字符的关键字长度都是 sizeof(CharType) 的倍数，终点对齐则起点也对齐
+        const uint32_t length = match_length_[state];
+        if (0 != length && 0 == i % sizeof(CharType)) {
+          const size_t start = i - length;
+          if (!found || start < found_start ||
+              (start == found_start && length > found_length)) {
+            found = true;
+            found_start = start;
+            found_length = length;
+            found_index = match_index_[state];
+          }
+        }
+        // 后面的命中起点不会早于 i - depth_[state]
+        if (found && i - depth_[state] > found_start) {
+          break;
+        }
+      }
+      if (!found) {
+        break;
+      }
+
+      if (0 == replace_times) {
+        result->clear();
+        result->reserve(source.size());
+      }
+      result->append(source.data() + copied / sizeof(CharType),
+                     (found_start - copied) / sizeof(CharType));
+      result->append(replacements_[found_index]);
+      ++replace_times;
+      copied = found_start + found_length;
+      i = copied;
+      state = 0;
+      found = false;
+    }
+
+    if (0 < replace_times) {
+      result->append(source.data() + copied / sizeof(CharType),
+                     (byte_size - copied) / sizeof(CharType));
+    }
+    return replace_times;
+  }
+
+ private:
+  template <class Table>
+  void Build(const Table& table) {
+    // 字节等价类，0 留给关键字中没出现过的字节
+    uint32_t byte_count = 0;
+    for (const auto& e : table) {
+      const view_type find(e.first);
+      const auto* bytes = reinterpret_cast<const uint8_t*>(find.data());
+      for (size_t i = 0; i < find.size() * sizeof(CharType); ++i) {
+        if (0 == byte_class_[bytes[i]]) {
+          byte_class_[bytes[i]] = static_cast<uint16_t>(++byte_count);
+        }
+      }
+    }
+    class_count_ = byte_count + 1;
+
+    // trie，0 表示没有边（root 不会是任何状态的孩子）
+    AddState(0);
+    for (const auto& e : table) {
+      const view_type find(e.first);
+      if (find.empty()) {
+        continue;
+      }
+      const auto* bytes = reinterpret_cast<const uint8_t*>(find.data());
+      uint32_t state = 0;
+      for (size_t i = 0; i < find.size() * sizeof(CharType); ++i) {
+        const size_t edge = state * class_count_ + byte_class_[bytes[i]];
+        if (0 == next_[edge]) {
+          // AddState 会让 next_ 重新分配，不能先取引用
+          const uint32_t child = AddState(depth_[state] + 1);
+          next_[edge] = child;
+        }
+        state = next_[edge];
+      }
+      // 重复的关键字以第一个为准
+      if (0 == match_length_[state]) {
+        match_length_[state] = depth_[state];
+        match_index_[state] = static_cast<uint32_t>(replacements_.size());
+        replacements_.emplace_back(view_type(e.second));
+      }
+    }
+
+    // BFS 补全失败转移，得到 DFA
+    std::vector<uint32_t> fail(depth_.size(), 0);
+    std::queue<uint32_t> pending;
+    for (size_t c = 0; c < class_count_; ++c) {
+      const uint32_t child = next_[c];
+      if (0 != child) {
+        pending.push(child);
+      }
+    }
+    while (!pending.empty()) {
+      const uint32_t state = pending.front();
+      pending.pop();
+      if (0 == match_length_[state]) {
+        match_length_[state] = match_length_[fail[state]];
+        match_index_[state] = match_index_[fail[state]];
+      }
+      for (size_t c = 0; c < class_count_; ++c) {
+        uint32_t& next = next_[state * class_count_ + c];
+        const uint32_t fallback = next_[fail[state] * class_count_ + c];
+        if (0 == next) {
+          next = fallback;
+        } else {
+          fail[next] = fallback;
+          pending.push(next);
+        }
+      }
+    }
+  }
+
+  uint32_t AddState(uint32_t depth) {
+    const auto state = static_cast<uint32_t>(depth_.size());
+    next_.resize(next_.size() + class_count_, 0);
+    depth_.push_back(depth);
+    match_length_.push_back(0);
+    match_index_.push_back(0);
+    return state;
+  }
+
+  std::array<uint16_t, 256> byte_class_{};
+  size_t class_count_ = 1;
+  // next_[state * class_count_ + byte_class_[byte]]
+  std::vector<uint32_t> next_;
+  // 以下长度单位都是字节
+  std::vector<uint32_t> depth_;
+  std::vector<uint32_t> match_length_;
+  std::vector<uint32_t> match_index_;
+  std::vector<std::basic_string<CharType>> replacements_;
+};
+}  // end of namespace string
+}  // end of namespace umu
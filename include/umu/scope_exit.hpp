@@ -1,34 +1,116 @@
-#pragma once
+﻿#pragma once
 
+#include <exception>
 #include <functional>
+#include <type_traits>
+#include <utility>
 
-// C++11
+// C++17
+// 回调直接存放在 guard 对象里，不经过 std::function，不分配内存。
+//   ON_SCOPE_EXIT([&] { ... });     // 总是执行
+//   ON_SCOPE_FAIL([&] { ... });     // 因异常离开作用域时执行
+//   ON_SCOPE_SUCCESS([&] { ... });  // 正常离开作用域时执行
+// 需要 Dismiss 或者移动 guard 时用 MakeScopeExit 等函数：
+//   auto guard = umu::MakeScopeExit([&] { ... });
+//   guard.Dismiss();
 
 namespace umu {
-class ScopeGuard {
+namespace detail {
+struct ScopeExitPolicy {
+  bool ShouldRun() const noexcept { return true; }
+};
+
+// 以构造时未捕获异常的个数为基准，嵌套在析构函数里使用也能正确判断
+struct ScopeFailPolicy {
+  bool ShouldRun() const noexcept {
+    return std::uncaught_exceptions() > uncaught_exceptions_;
+  }
+
+  int uncaught_exceptions_ = std::uncaught_exceptions();
+};
+
+struct ScopeSuccessPolicy {
+  bool ShouldRun() const noexcept {
+    return std::uncaught_exceptions() <= uncaught_exceptions_;
+  }
+
+  int uncaught_exceptions_ = std::uncaught_exceptions();
+};
+
+template <class Callback, class Policy>
+class BasicScopeGuard : private Policy {
  public:
-  explicit ScopeGuard(std::function<void()> on_exit_scope)
-      : on_exit_scope_(on_exit_scope), dismissed_(false) {}
+  template <class F,
+            class = std::enable_if_t<
+                !std::is_same_v<std::decay_t<F>, BasicScopeGuard>>>
+  explicit BasicScopeGuard(F&& on_exit_scope) noexcept(
+      std::is_nothrow_constructible_v<Callback, F>)
+      : on_exit_scope_(std::forward<F>(on_exit_scope)) {}
+
+  // 被移动的 guard 不再执行回调
+  BasicScopeGuard(BasicScopeGuard&& other) noexcept(
+      std::is_nothrow_move_constructible_v<Callback>)
+      : Policy(other),
+        on_exit_scope_(std::move(other.on_exit_scope_)),
+        dismissed_(other.dismissed_) {
+    other.dismissed_ = true;
+  }
 
-  ~ScopeGuard() noexcept {
-    if (!dismissed_) {
+  // ScopeSuccess 的回调允许抛出异常，其余两种在异常处理中执行，不能再抛出
+  ~BasicScopeGuard() noexcept(
+      !std::is_same_v<Policy, ScopeSuccessPolicy> ||
+      std::is_nothrow_invocable_v<Callback&>) {
+    if (!dismissed_ && this->ShouldRun()) {
       on_exit_scope_();
     }
   }
 
-  void Dismiss() { dismissed_ = true; }
+  void Dismiss() noexcept { dismissed_ = true; }
 
  private:
-  std::function<void()> on_exit_scope_;
-  bool dismissed_;
+  Callback on_exit_scope_;
+  bool dismissed_ = false;
 
   // noncopyable
-  ScopeGuard(ScopeGuard const&) = delete;
-  ScopeGuard& operator=(ScopeGuard const&) = delete;
+  BasicScopeGuard(const BasicScopeGuard&) = delete;
+  BasicScopeGuard& operator=(const BasicScopeGuard&) = delete;
+  BasicScopeGuard& operator=(BasicScopeGuard&&) = delete;
 };
+}  // namespace detail
+
+template <class Callback>
+using ScopeExit = detail::BasicScopeGuard<Callback, detail::ScopeExitPolicy>;
+template <class Callback>
+using ScopeFail = detail::BasicScopeGuard<Callback, detail::ScopeFailPolicy>;
+template <class Callback>
+using ScopeSuccess =
+    detail::BasicScopeGuard<Callback, detail::ScopeSuccessPolicy>;
+
+// 类型擦除的版本，用于需要写出具体类型的地方，例如类成员
+using ScopeGuard = ScopeExit<std::function<void()>>;
+
+template <class F>
+[[nodiscard]] ScopeExit<std::decay_t<F>> MakeScopeExit(F&& on_exit_scope) {
+  return ScopeExit<std::decay_t<F>>(std::forward<F>(on_exit_scope));
+}
+
+template <class F>
+[[nodiscard]] ScopeFail<std::decay_t<F>> MakeScopeFail(F&& on_fail) {
+  return ScopeFail<std::decay_t<F>>(std::forward<F>(on_fail));
+}
+
+template <class F>
+[[nodiscard]] ScopeSuccess<std::decay_t<F>> MakeScopeSuccess(F&& on_success) {
+  return ScopeSuccess<std::decay_t<F>>(std::forward<F>(on_success));
+}
 }  // end of namespace umu
 
 #define SCOPEGUARD_LINENAME_CAT(name, line) name##line
 #define SCOPEGUARD_LINENAME(name, line) SCOPEGUARD_LINENAME_CAT(name, line)
-#define ON_SCOPE_EXIT(callback) \
-  umu::ScopeGuard SCOPEGUARD_LINENAME(EXIT, __LINE__)(callback)
+// 可变参数，捕获列表里的逗号不会被当作宏参数分隔符
+#define ON_SCOPE_EXIT(...) \
+  auto SCOPEGUARD_LINENAME(EXIT, __LINE__) = umu::MakeScopeExit(__VA_ARGS__)
+#define ON_SCOPE_FAIL(...) \
+  auto SCOPEGUARD_LINENAME(FAIL, __LINE__) = umu::MakeScopeFail(__VA_ARGS__)
+#define ON_SCOPE_SUCCESS(...) \
+  auto SCOPEGUARD_LINENAME(SUCCESS, __LINE__) = umu::MakeScopeSuccess(__VA_ARGS__)
@@ -0,0 +1,500 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#if !defined(UMU_DISABLE_SIMD) &&                                    \
+    (defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define UMU_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define UMU_TARGET_AVX2
+#else
+#define UMU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// 字符分类/替换的向量化内核：SSE2 支持 char/char16_t/wchar_t；
+// AVX2 的字符集合查找只用于单字节字符，单字符替换各种宽度都用。
+// 运行时检测 CPU，其他平台退回标量
+namespace umu {
+namespace simd {
+namespace detail {
+inline uint32_t CountTrailingZeros(uint32_t mask) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+inline uint32_t HighestBit(uint32_t mask) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanReverse(&index, mask);
+  return index;
+#else
+  return 31 - static_cast<uint32_t>(__builtin_clz(mask));
+#endif
+}
+
+// 不依赖 POPCNT 指令，SSE2 路径在老 CPU 上也能跑
+inline uint32_t PopCount(uint32_t mask) noexcept {
+  mask = mask - ((mask >> 1) & 0x55555555);
+  mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+  return (((mask + (mask >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+template <typename CharType>
+struct Scanner;
+}  // namespace detail
+
+#if UMU_SIMD_X86
+inline bool HasAvx2() noexcept {
+  static const bool has_avx2 = [] {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+      return false;
+    }
+    __cpuid(info, 1);
+    // OSXSAVE && AVX
+    if ((info[2] & 0x18000000) != 0x18000000) {
+      return false;
+    }
+    // OS 保存了 XMM/YMM 状态
+    if ((_xgetbv(0) & 6) != 6) {
+      return false;
+    }
+    __cpuidex(info, 7, 0);
+    return 0 != (info[1] & 0x20);
+#else
+    return 0 != __builtin_cpu_supports("avx2");
+#endif
+  }();
+  return has_avx2;
+}
+#else
+constexpr bool HasAvx2() noexcept {
+  return false;
+}
+#endif
+
+// 字符集合：256 位 bitmap 给标量路径，高/低半字节表给 AVX2 pshufb，
+// 不超过 16 个成员时 SSE2 逐个比较。宽字符成员 > 0xFF 时只走标量
+template <typename CharType>
+class CharSet {
+ public:
+  using view_type = std::basic_string_view<CharType>;
+  using unsigned_type = std::make_unsigned_t<CharType>;
+
+  static constexpr size_t kMaxCompareCount = 16;
+
+  constexpr CharSet() noexcept = default;
+
+  // chars 必须比 CharSet 活得久
+  constexpr explicit CharSet(view_type chars) noexcept : chars_(chars) {
+    for (const CharType c : chars) {
+      const auto u = static_cast<unsigned_type>(c);
+      if (u > 0xFF) {
+        bytewise_ = false;
+        continue;
+      }
+      const auto b = static_cast<uint8_t>(u);
+      if (0 != (bits_[b >> 6] & (uint64_t{1} << (b & 63)))) {
+        continue;
+      }
+      bits_[b >> 6] |= uint64_t{1} << (b & 63);
+      if (b < 0x80) {
+        nibble_low_[b & 0x0F] |= static_cast<uint8_t>(1 << (b >> 4));
+      } else {
+        nibble_high_[b & 0x0F] |= static_cast<uint8_t>(1 << ((b >> 4) - 8));
+      }
+      if (member_count_ < kMaxCompareCount) {
+        members_[member_count_] = b;
+      }
+      ++member_count_;
+    }
+  }
+
+  [[nodiscard]] constexpr bool Contains(CharType c) const noexcept {
+    const auto u = static_cast<unsigned_type>(c);
+    if (u > 0xFF) {
+      return !bytewise_ && view_type::npos != chars_.find(c);
+    }
+    return 0 != (bits_[u >> 6] & (uint64_t{1} << (u & 63)));
+  }
+
+  [[nodiscard]] constexpr view_type chars() const noexcept { return chars_; }
+
+ private:
+  template <typename>
+  friend struct detail::Scanner;
+
+  view_type chars_;
+  uint64_t bits_[4]{};
+  uint8_t nibble_low_[16]{};
+  uint8_t nibble_high_[16]{};
+  uint8_t members_[kMaxCompareCount]{};
+  size_t member_count_ = 0;
+  bool bytewise_ = true;
+};
+
+namespace detail {
+template <typename CharType>
+struct Scanner {
+  using view_type = std::basic_string_view<CharType>;
+
+  static constexpr size_t npos = view_type::npos;
+  static constexpr size_t kLanes = 16 / sizeof(CharType);
+
+  static size_t FindFirst(view_type s,
+                          const CharSet<CharType>& set,
+                          size_t pos,
+                          bool negate) noexcept {
+    if (pos >= s.size()) {
+      return npos;
+    }
+    const CharType* const first = s.data();
+    const CharType* p = first + pos;
+    const CharType* const last = first + s.size();
+#if UMU_SIMD_X86
+    if (set.bytewise_) {
+      if constexpr (1 == sizeof(CharType)) {
+        if (last - p >= 32 && HasAvx2()) {
+          const CharType* found = FindFirstAvx2(p, last, set, negate);
+          if (nullptr != found) {
+            return found - first;
+          }
+        }
+      }
+      if (set.member_count_ <= CharSet<CharType>::kMaxCompareCount) {
+        for (; last - p >= 16; p += 16) {
+          uint32_t mask = MatchMask(p, set);
+          if (negate) {
+            mask ^= 0xFFFF;
+          }
+          if (0 != mask) {
+            return p - first + CountTrailingZeros(mask);
+          }
+        }
+      }
+    }
+#endif
+    for (; p < last; ++p) {
+      if (set.Contains(*p) != negate) {
+        return p - first;
+      }
+    }
+    return npos;
+  }
+
+  static size_t FindLast(view_type s,
+                         const CharSet<CharType>& set,
+                         size_t pos,
+                         bool negate) noexcept {
+    if (s.empty()) {
+      return npos;
+    }
+    const CharType* const first = s.data();
+    const CharType* p = first + (pos < s.size() ? pos + 1 : s.size());
+#if UMU_SIMD_X86
+    if (set.bytewise_) {
+      if constexpr (1 == sizeof(CharType)) {
+        if (p - first >= 32 && HasAvx2()) {
+          const CharType* found = FindLastAvx2(first, p, set, negate);
+          if (nullptr != found) {
+            return found - first;
+          }
+        }
+      }
+      if (set.member_count_ <= CharSet<CharType>::kMaxCompareCount) {
+        while (p - first >= 16) {
+          p -= 16;
+          uint32_t mask = MatchMask(p, set);
+          if (negate) {
+            mask ^= 0xFFFF;
+          }
+          if (0 != mask) {
+            return p - first + HighestBit(mask);
+          }
+        }
+      }
+    }
+#endif
+    while (p > first) {
+      --p;
+      if (set.Contains(*p) != negate) {
+        return p - first;
+      }
+    }
+    return npos;
+  }
+
+  static size_t Replace(CharType* data,
+                        size_t size,
+                        CharType find,
+                        CharType replace_with) noexcept {
+    size_t replace_times = 0;
+    CharType* p = data;
+    CharType* const last = data + size;
+#if UMU_SIMD_X86
+    if (last - p >= static_cast<ptrdiff_t>(2 * kLanes) && HasAvx2()) {
+      replace_times += ReplaceAvx2(p, last, find, replace_with);
+    }
+    const __m128i find_vector = Broadcast(find);
+    const __m128i replace_vector = Broadcast(replace_with);
+    for (; last - p >= static_cast<ptrdiff_t>(kLanes); p += kLanes) {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      const __m128i equal = CompareEqual(v, find_vector);
+      const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(equal));
+      if (0 != mask) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p),
+                         _mm_or_si128(_mm_and_si128(equal, replace_vector),
+                                      _mm_andnot_si128(equal, v)));
+        replace_times += PopCount(mask) / sizeof(CharType);
+      }
+    }
+#endif
+    for (; p < last; ++p) {
+      if (*p == find) {
+        *p = replace_with;
+        ++replace_times;
+      }
+    }
+    return replace_times;
+  }
+
+#if UMU_SIMD_X86
+  // 16 个元素压成 16 个字节，valid 标出值不超过 0xFF 的元素
+  static __m128i Load(const CharType* p, __m128i* valid) noexcept {
+    const auto* v = reinterpret_cast<const __m128i*>(p);
+    if constexpr (1 == sizeof(CharType)) {
+      *valid = _mm_set1_epi8(-1);
+      return _mm_loadu_si128(v);
+    } else if constexpr (2 == sizeof(CharType)) {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i low_byte = _mm_set1_epi16(0xFF);
+      const __m128i a = _mm_loadu_si128(v);
+      const __m128i b = _mm_loadu_si128(v + 1);
+      *valid =
+          _mm_packs_epi16(_mm_cmpeq_epi16(_mm_srli_epi16(a, 8), zero),
+                          _mm_cmpeq_epi16(_mm_srli_epi16(b, 8), zero));
+      return _mm_packus_epi16(_mm_and_si128(a, low_byte),
+                              _mm_and_si128(b, low_byte));
+    } else {
+      static_assert(4 == sizeof(CharType));
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i low_byte = _mm_set1_epi32(0xFF);
+      const __m128i a = _mm_loadu_si128(v);
+      const __m128i b = _mm_loadu_si128(v + 1);
+      const __m128i c = _mm_loadu_si128(v + 2);
+      const __m128i d = _mm_loadu_si128(v + 3);
+      *valid = _mm_packs_epi16(
+          _mm_packs_epi32(_mm_cmpeq_epi32(_mm_srli_epi32(a, 8), zero),
+                          _mm_cmpeq_epi32(_mm_srli_epi32(b, 8), zero)),
+          _mm_packs_epi32(_mm_cmpeq_epi32(_mm_srli_epi32(c, 8), zero),
+                          _mm_cmpeq_epi32(_mm_srli_epi32(d, 8), zero)));
+      return _mm_packus_epi16(
+          _mm_packs_epi32(_mm_and_si128(a, low_byte),
+                          _mm_and_si128(b, low_byte)),
+          _mm_packs_epi32(_mm_and_si128(c, low_byte),
+                          _mm_and_si128(d, low_byte)));
+    }
+  }
+
+  static uint32_t MatchMask(const CharType* p,
+                            const CharSet<CharType>& set) noexcept {
+    __m128i valid;
+    const __m128i v = Load(p, &valid);
+    __m128i match = _mm_setzero_si128();
+    for (size_t i = 0; i < set.member_count_; ++i) {
+      match = _mm_or_si128(
+          match,
+          _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(set.members_[i]))));
+    }
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(match, valid)));
+  }
+
+  static __m128i Broadcast(CharType c) noexcept {
+    if constexpr (1 == sizeof(CharType)) {
+      return _mm_set1_epi8(static_cast<char>(c));
+    } else if constexpr (2 == sizeof(CharType)) {
+      return _mm_set1_epi16(static_cast<short>(c));
+    } else {
+      return _mm_set1_epi32(static_cast<int>(c));
+    }
+  }
+
+  static __m128i CompareEqual(__m128i a, __m128i b) noexcept {
+    if constexpr (1 == sizeof(CharType)) {
+      return _mm_cmpeq_epi8(a, b);
+    } else if constexpr (2 == sizeof(CharType)) {
+      return _mm_cmpeq_epi16(a, b);
+    } else {
+      return _mm_cmpeq_epi32(a, b);
+    }
+  }
+
+  // 每个字节 b：低半字节查表得到高半字节的位图，再用高半字节选位
+  struct NibbleTables {
+    __m256i low;
+    __m256i high;
+    __m256i bit;
+    __m256i nibble_mask;
+  };
+
+  UMU_TARGET_AVX2 static NibbleTables MakeNibbleTables(
+      const CharSet<CharType>& set) noexcept {
+    return {_mm256_broadcastsi128_si256(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(set.nibble_low_))),
+            _mm256_broadcastsi128_si256(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(set.nibble_high_))),
+            _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32,
+                             64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4,
+                             8, 16, 32, 64, -128),
+            _mm256_set1_epi8(0x0F)};
+  }
+
+  UMU_TARGET_AVX2 static uint32_t MatchMaskAvx2(
+      const CharType* p,
+      const NibbleTables& tables) noexcept {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const __m256i low = _mm256_and_si256(v, tables.nibble_mask);
+    const __m256i high =
+        _mm256_and_si256(_mm256_srli_epi16(v, 4), tables.nibble_mask);
+    // 最高位为 1 的字节（高半字节 >= 8）取 high 表
+    const __m256i row =
+        _mm256_blendv_epi8(_mm256_shuffle_epi8(tables.low, low),
+                           _mm256_shuffle_epi8(tables.high, low), v);
+    const __m256i bit = _mm256_shuffle_epi8(tables.bit, high);
+    return static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit)));
+  }
+
+  // 返回命中位置；未命中返回 nullptr，p 前进到剩余不足 32 字节处
+  UMU_TARGET_AVX2 static const CharType* FindFirstAvx2(
+      const CharType*& p,
+      const CharType* last,
+      const CharSet<CharType>& set,
+      bool negate) noexcept {
+    const NibbleTables tables = MakeNibbleTables(set);
+    const uint32_t flip = negate ? 0xFFFFFFFF : 0;
+    for (; last - p >= 32; p += 32) {
+      const uint32_t mask = MatchMaskAvx2(p, tables) ^ flip;
+      if (0 != mask) {
+        return p + CountTrailingZeros(mask);
+      }
+    }
+    return nullptr;
+  }
+
+  UMU_TARGET_AVX2 static const CharType* FindLastAvx2(
+      const CharType* first,
+      const CharType*& p,
+      const CharSet<CharType>& set,
+      bool negate) noexcept {
+    const NibbleTables tables = MakeNibbleTables(set);
+    const uint32_t flip = negate ? 0xFFFFFFFF : 0;
+    while (p - first >= 32) {
+      p -= 32;
+      const uint32_t mask = MatchMaskAvx2(p, tables) ^ flip;
+      if (0 != mask) {
+        return p + HighestBit(mask);
+      }
+    }
+    return nullptr;
+  }
+
+  UMU_TARGET_AVX2 static size_t ReplaceAvx2(CharType*& p,
+                                            CharType* last,
+                                            CharType find,
+                                            CharType replace_with) noexcept {
+    __m256i find_vector;
+    __m256i replace_vector;
+    if constexpr (1 == sizeof(CharType)) {
+      find_vector = _mm256_set1_epi8(static_cast<char>(find));
+      replace_vector = _mm256_set1_epi8(static_cast<char>(replace_with));
+    } else if constexpr (2 == sizeof(CharType)) {
+      find_vector = _mm256_set1_epi16(static_cast<short>(find));
+      replace_vector = _mm256_set1_epi16(static_cast<short>(replace_with));
+    } else {
+      find_vector = _mm256_set1_epi32(static_cast<int>(find));
+      replace_vector = _mm256_set1_epi32(static_cast<int>(replace_with));
+    }
+    size_t replace_times = 0;
+    for (; last - p >= static_cast<ptrdiff_t>(2 * kLanes); p += 2 * kLanes) {
+      const __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i*>(p));
+      __m256i equal;
+      if constexpr (1 == sizeof(CharType)) {
+        equal = _mm256_cmpeq_epi8(v, find_vector);
+      } else if constexpr (2 == sizeof(CharType)) {
+        equal = _mm256_cmpeq_epi16(v, find_vector);
+      } else {
+        equal = _mm256_cmpeq_epi32(v, find_vector);
+      }
+      const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(equal));
+      if (0 != mask) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p),
+                            _mm256_blendv_epi8(v, replace_vector, equal));
+        replace_times += PopCount(mask) / sizeof(CharType);
+      }
+    }
+    return replace_times;
+  }
+#endif
+};
+}  // namespace detail
+
+template <typename CharType>
+[[nodiscard]] inline size_t FindFirstOf(std::basic_string_view<CharType> s,
+                                        const CharSet<CharType>& set,
+                                        size_t pos = 0) noexcept {
+  return detail::Scanner<CharType>::FindFirst(s, set, pos, false);
+}
+
+template <typename CharType>
+[[nodiscard]] inline size_t FindFirstNotOf(std::basic_string_view<CharType> s,
+                                           const CharSet<CharType>& set,
+                                           size_t pos = 0) noexcept {
+  return detail::Scanner<CharType>::FindFirst(s, set, pos, true);
+}
+
+template <typename CharType>
+[[nodiscard]] inline size_t FindLastOf(
+    std::basic_string_view<CharType> s,
+    const CharSet<CharType>& set,
+    size_t pos = std::basic_string_view<CharType>::npos) noexcept {
+  return detail::Scanner<CharType>::FindLast(s, set, pos, false);
+}
+
+template <typename CharType>
+[[nodiscard]] inline size_t FindLastNotOf(
+    std::basic_string_view<CharType> s,
+    const CharSet<CharType>& set,
+    size_t pos = std::basic_string_view<CharType>::npos) noexcept {
+  return detail::Scanner<CharType>::FindLast(s, set, pos, true);
+}
+
+// 返回替换次数
+template <typename CharType>
+inline size_t Replace(CharType* data,
+                      size_t size,
+                      CharType find,
+                      CharType replace_with) noexcept {
+  return detail::Scanner<CharType>::Replace(data, size, find, replace_with);
+}
+}  // namespace simd
+}  // namespace umu
@@ -1,10 +1,22 @@
 ﻿#pragma once
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
+#include <initializer_list>
+#include <iterator>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "case_fold.h"
+#include "encoding.h"
+#include "fixed_string.hpp"
+#include "inplace_string.hpp"
+#include "replace_automaton.hpp"
+#include "simd.h"
 #include "umu.h"
 
 namespace umu {
@@ -60,9 +72,9 @@ CONSTEXPR std::basic_string<CharType> ArrayJoin(
 #pragma region "Split"
 // source_string 末尾如果是 separator，其后的空白不被加入
 // container，只有中间的空白会被加入 container
-template <class StringType, class StringOrCharType>
+template <class StringType, class StringOrCharType, class Allocator>
 inline typename StringType::size_type split(
-    std::vector<StringType>* container,
+    std::vector<StringType, Allocator>* container,
     const StringType& source_string,
     const StringOrCharType separator,
     const typename StringType::size_type separator_size) {
@@ -78,9 +90,8 @@ inline typename StringType::size_type split(
 
   do {
     end = source_string.find(separator, start);
-    StringType e(source_string.substr(start, end - start));
     if (nullptr != container) {
-      container->push_back(e);
+      container->emplace_back(source_string.substr(start, end - start));
     }
     start = end + separator_size;
     ++size;
@@ -89,44 +100,45 @@ inline typename StringType::size_type split(
   return size;
 }
 
-template <class StringType>
-inline typename StringType::size_type Split(std::vector<StringType>* container,
-                                            const StringType& source_string,
-                                            const StringType& separator) {
+template <class StringType, class Allocator>
+inline typename StringType::size_type Split(
+    std::vector<StringType, Allocator>* container,
+    const StringType& source_string,
+    const StringType& separator) {
   const auto separator_size = static_cast<StringType>(separator).size();
   return split(container, source_string, separator, separator_size);
 }
 
-template <class StringType>
+template <class StringType, class Allocator>
 inline typename StringType::size_type Split(
-    std::vector<StringType>* container,
+    std::vector<StringType, Allocator>* container,
     const StringType& source_string,
     const typename StringType::value_type separator) {
   const typename StringType::size_type separator_size = 1;
   return split(container, source_string, separator, separator_size);
 }
 
-template <class StringType>
+template <class StringType, class Allocator>
 inline typename StringType::size_type Split(
-    std::vector<StringType>* container,
+    std::vector<StringType, Allocator>* container,
     const StringType& source_string,
     const typename StringType::value_type* separator) {
   return Split(container, source_string, StringType(separator));
 }
 
-template <class StringType, class StringOrCharType>
+template <class StringType, class StringOrCharType, class Allocator>
 inline typename StringType::size_type Split(
-    std::vector<StringType>* container,
+    std::vector<StringType, Allocator>* container,
     const typename StringType::value_type* source_string,
-    const typename StringOrCharType separator) {
+    const StringOrCharType separator) {
   return Split(container, StringType(source_string), separator);
 }
 #pragma endregion
 
 #pragma region "SplitAnyOf"
-template <class StringType>
+template <class StringType, class Allocator>
 inline typename StringType::size_type SplitAnyOf(
-    std::vector<StringType>* container,
+    std::vector<StringType, Allocator>* container,
     const StringType& source_string,
     const StringType& token) {
   using size_type = typename StringType::size_type;
@@ -134,16 +146,20 @@ inline typename StringType::size_type SplitAnyOf(
   if (nullptr != container) {
     container->clear();
   }
+  using CharType = typename StringType::value_type;
   const size_type source_size = source_string.size();
+  const std::basic_string_view<CharType> source_view(source_string.data(),
+                                                     source_size);
+  const simd::CharSet<CharType> token_set(
+      std::basic_string_view<CharType>(token.data(), token.size()));
   size_type size = 0;
   size_type start = 0;
   size_type end;
 
   do {
-    end = source_string.find_first_of(token, start);
-    StringType e(source_string.substr(start, end - start));
+    end = simd::FindFirstOf(source_view, token_set, start);
     if (nullptr != container) {
-      container->push_back(e);
+      container->emplace_back(source_string.substr(start, end - start));
     }
     start = end + 1;
     ++size;
@@ -152,39 +168,284 @@ inline typename StringType::size_type SplitAnyOf(
   return size;
 }
 
-template <class StringType>
+template <class StringType, class Allocator>
 inline typename StringType::size_type SplitAnyOf(
-    std::vector<StringType>* container,
+    std::vector<StringType, Allocator>* container,
     const StringType& source_string,
     const typename StringType::value_type* token) {
   return SplitAnyOf(container, source_string, StringType(token));
 }
 
-template <class StringType>
+template <class StringType, class Allocator>
 inline typename StringType::size_type SplitAnyOf(
-    std::vector<StringType>* container,
+    std::vector<StringType, Allocator>* container,
     const typename StringType::value_type* source_string,
     const typename StringType::value_type* token) {
   return SplitAnyOf(container, StringType(source_string), StringType(token));
 }
 #pragma endregion
 
+#pragma region "SplitView"
+namespace detail {
+template <typename CharType>
+constexpr std::basic_string_view<CharType> ToStringView(
+    std::basic_string_view<CharType> s) noexcept {
+  return s;
+}
+
+template <typename CharType, class Allocator>
+constexpr std::basic_string_view<CharType> ToStringView(
+    const std::basic_string<CharType, std::char_traits<CharType>, Allocator>&
+        s) noexcept {
+  return {s.data(), s.size()};
+}
+
+template <typename CharType>
+constexpr std::basic_string_view<CharType> ToStringView(
+    const CharType* s) noexcept {
+  return s;
+}
+
+template <typename CharType, size_t N>
+constexpr std::basic_string_view<CharType> ToStringView(
+    const fixed_string<CharType, N>& s) noexcept {
+  return s.view();
+}
+
+template <typename CharType, size_t N, class Policy>
+inline std::basic_string_view<CharType> ToStringView(
+    const inplace_basic_string<CharType, N, Policy>& s) noexcept {
+  return s.view();
+}
+
+template <typename CharType>
+struct SeparatorFinder {
+  constexpr size_t Find(std::basic_string_view<CharType> s,
+                        size_t pos) const noexcept {
+    return s.find(separator, pos);
+  }
+  constexpr size_t Size() const noexcept { return separator.size(); }
+
+  std::basic_string_view<CharType> separator;
+};
+
+template <typename CharType>
+struct CharFinder {
+  constexpr size_t Find(std::basic_string_view<CharType> s,
+                        size_t pos) const noexcept {
+    return s.find(separator, pos);
+  }
+  constexpr size_t Size() const noexcept { return 1; }
+
+  CharType separator;
+};
+
+template <typename CharType>
+struct AnyOfFinder {
+  constexpr size_t Find(std::basic_string_view<CharType> s,
+                        size_t pos) const noexcept {
+#if UMU_HAS_CXX20
+    if (std::is_constant_evaluated()) {
+      return s.find_first_of(token.chars(), pos);
+    }
+#endif
+    return simd::FindFirstOf(s, token, pos);
+  }
+  constexpr size_t Size() const noexcept { return 1; }
+
+  simd::CharSet<CharType> token;
+};
+}  // namespace detail
+
+// 惰性切分，和 Split/SplitAnyOf 的空字段规则一致：末尾 separator
+// 之后的空白不产生 token。token 是 source 的 view，source 必须比 range 活得久
+template <typename CharType, class Finder>
+class SplitRange {
+ public:
+  using view_type = std::basic_string_view<CharType>;
+  using size_type = typename view_type::size_type;
+
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = view_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const view_type*;
+    using reference = const view_type&;
+
+    constexpr iterator() noexcept = default;
+
+    constexpr reference operator*() const noexcept { return token_; }
+    constexpr pointer operator->() const noexcept { return &token_; }
+
+    constexpr iterator& operator++() noexcept {
+      if (view_type::npos == end_) {
+        start_ = view_type::npos;
+        return *this;
+      }
+      start_ = end_ + finder_.Size();
+      if (start_ < source_.size()) {
+        Next();
+      } else {
+        start_ = view_type::npos;
+      }
+      return *this;
+    }
+
+    constexpr iterator operator++(int) noexcept {
+      iterator old(*this);
+      ++*this;
+      return old;
+    }
+
+    friend constexpr bool operator==(const iterator& lhs,
+                                     const iterator& rhs) noexcept {
+      return lhs.start_ == rhs.start_;
+    }
+    friend constexpr bool operator!=(const iterator& lhs,
+                                     const iterator& rhs) noexcept {
+      return lhs.start_ != rhs.start_;
+    }
+
+   private:
+    friend class SplitRange;
+
+    constexpr iterator(view_type source, Finder finder) noexcept
+        : source_(source), finder_(finder), start_(0) {
+      Next();
+    }
+
+    constexpr void Next() noexcept {
+      // 空 separator 会让 find 原地踏步，整个 source 作为一个 token
+      end_ = 0 == finder_.Size() ? view_type::npos
+                                 : finder_.Find(source_, start_);
+      token_ = source_.substr(start_, end_ - start_);
+    }
+
+    view_type source_;
+    Finder finder_{};
+    size_type start_ = view_type::npos;
+    size_type end_ = view_type::npos;
+    view_type token_;
+  };
+
+  constexpr SplitRange(view_type source, Finder finder) noexcept
+      : source_(source), finder_(finder) {}
+
+  [[nodiscard]] constexpr iterator begin() const noexcept {
+    return iterator(source_, finder_);
+  }
+  [[nodiscard]] constexpr iterator end() const noexcept { return iterator(); }
+
+ private:
+  view_type source_;
+  Finder finder_;
+};
+
+template <class SourceType, class SeparatorType>
+[[nodiscard]] constexpr auto SplitView(const SourceType& source,
+                                       const SeparatorType& separator) {
+  const auto source_view = detail::ToStringView(source);
+  using CharType = typename decltype(source_view)::value_type;
+  if constexpr (std::is_same_v<SeparatorType, CharType>) {
+    return SplitRange<CharType, detail::CharFinder<CharType>>(
+        source_view, {separator});
+  } else {
+    return SplitRange<CharType, detail::SeparatorFinder<CharType>>(
+        source_view, {detail::ToStringView(separator)});
+  }
+}
+
+template <class SourceType, class TokenType>
+[[nodiscard]] constexpr auto SplitAnyOfView(const SourceType& source,
+                                            const TokenType& token) {
+  const auto source_view = detail::ToStringView(source);
+  using CharType = typename decltype(source_view)::value_type;
+  return SplitRange<CharType, detail::AnyOfFinder<CharType>>(
+      source_view,
+      {simd::CharSet<CharType>(detail::ToStringView(token))});
+}
+
+// container 只 clear 不释放，重复使用同一个 container 时不会再分配内存
+template <typename CharType, class SourceType, class SeparatorType>
+inline size_t SplitView(
+    std::vector<std::basic_string_view<CharType>>* container,
+    const SourceType& source,
+    const SeparatorType& separator) {
+  size_t size = 0;
+  if (nullptr != container) {
+    container->clear();
+  }
+  for (const auto& e : SplitView(source, separator)) {
+    if (nullptr != container) {
+      container->push_back(e);
+    }
+    ++size;
+  }
+  return size;
+}
+
+template <typename CharType, class SourceType, class TokenType>
+inline size_t SplitAnyOfView(
+    std::vector<std::basic_string_view<CharType>>* container,
+    const SourceType& source,
+    const TokenType& token) {
+  size_t size = 0;
+  if (nullptr != container) {
+    container->clear();
+  }
+  for (const auto& e : SplitAnyOfView(source, token)) {
+    if (nullptr != container) {
+      container->push_back(e);
+    }
+    ++size;
+  }
+  return size;
+}
+#pragma endregion
+
 #pragma region "Replace"
+// 先数出命中次数，长度不变时原地覆盖，否则按最终长度一次拼出结果。
+// find 为空时不替换
 template <class StringType>
 inline typename StringType::size_type Replace(StringType& source_string,
                                               const StringType& find,
                                               const StringType& replace_with) {
-  typename StringType::size_type replace_times = 0;
-  typename StringType::size_type pos = 0;
-  for (;;) {
-    pos = source_string.find(find, pos);
-    if (StringType::npos == pos) {
-      break;
-    }
-    source_string.replace(pos, find.size(), replace_with);
+  using size_type = typename StringType::size_type;
+
+  const size_type find_size = find.size();
+  if (0 == find_size) {
+    return 0;
+  }
+  size_type replace_times = 0;
+  for (size_type pos = source_string.find(find); StringType::npos != pos;
+       pos = source_string.find(find, pos + find_size)) {
     ++replace_times;
-    pos += replace_with.size();
   }
+  if (0 == replace_times) {
+    return 0;
+  }
+
+  if (find_size == replace_with.size()) {
+    for (size_type pos = source_string.find(find); StringType::npos != pos;
+         pos = source_string.find(find, pos + find_size)) {
+      std::copy(replace_with.begin(), replace_with.end(),
+                source_string.begin() + pos);
+    }
+    return replace_times;
+  }
+
+  StringType result(source_string.get_allocator());
+  result.reserve(source_string.size() - replace_times * find_size +
+                 replace_times * replace_with.size());
+  size_type start = 0;
+  for (size_type pos = source_string.find(find); StringType::npos != pos;
+       pos = source_string.find(find, start)) {
+    result.append(source_string, start, pos - start).append(replace_with);
+    start = pos + find_size;
+  }
+  result.append(source_string, start, StringType::npos);
+  source_string.swap(result);
   return replace_times;
 }
 
@@ -209,26 +470,148 @@ inline typename StringType::size_type Replace(
     StringType& source_string,
     const typename StringType::value_type find,
     const typename StringType::value_type replace_with) {
-  typename StringType::size_type replace_times = 0;
-  for (auto it = source_string.begin(); it != source_string.end(); ++it) {
-    if (*it == find) {
-      *it = replace_with;
-      ++replace_times;
-    }
+  return simd::Replace(source_string.data(), source_string.size(), find,
+                       replace_with);
+}
+#pragma endregion
+
+#pragma region "ReplaceAll"
+// 一次扫描替换 automaton 中的所有关键字，同一起点取最长的。
+// automaton 预先构造后可以在多次调用间复用
+template <class StringType>
+inline typename StringType::size_type ReplaceAll(
+    StringType& source_string,
+    const ReplaceAutomaton<typename StringType::value_type>& automaton) {
+  StringType result(source_string.get_allocator());
+  const size_t replace_times = automaton.Replace(
+      detail::ToStringView(source_string), &result);
+  if (0 < replace_times) {
+    source_string.swap(result);
   }
   return replace_times;
 }
+
+template <class StringType>
+inline typename StringType::size_type ReplaceAll(
+    StringType& source_string,
+    std::initializer_list<std::pair<
+        std::basic_string_view<typename StringType::value_type>,
+        std::basic_string_view<typename StringType::value_type>>> table) {
+  return ReplaceAll(
+      source_string,
+      ReplaceAutomaton<typename StringType::value_type>(table));
+}
+#pragma endregion
+
+#pragma region "FixedArrayJoin"
+template <typename CharType>
+struct JoinTokensView {
+  std::basic_string_view<CharType> head;
+  std::basic_string_view<CharType> separator;
+  std::basic_string_view<CharType> tail;
+};
+
+namespace detail {
+// 有意和 JoinTokens 的默认值不同：JoinTokens 用 {'{', '\0'} 这样的初始化列表，
+// 每个记号都带一个 '\0'，ArrayJoin 的结果中间夹着 NUL。改它会改变已有调用方的
+// 输出，所以保持原样；这里只用可见字符，同样的输入 FixedArrayJoin 和 ArrayJoin
+// 的结果不相同
+template <typename CharType>
+struct DefaultJoinTokens {
+  static constexpr CharType head[] = {'{'};
+  static constexpr CharType separator[] = {',', ' '};
+  static constexpr CharType tail[] = {'}'};
+  static constexpr JoinTokensView<CharType> value{
+      {head, 1}, {separator, 2}, {tail, 1}};
+};
+
+template <class ArrayType>
+using ArrayCharType =
+    typename std::decay_t<ArrayType>::value_type::value_type;
+}  // namespace detail
+
+// 编译期拼接，结果是刚好放得下的 fixed_string，不在运行期分配内存：
+//   static constexpr std::array<std::string_view, 2> kColumns{"id", "name"};
+//   constexpr auto kSelect = FixedArrayJoin<kColumns>();
+// kArray/kTokens 须是静态存储期的 constexpr 对象。默认记号不带 '\0'，
+// 结果和 ArrayJoin 的不同，见 detail::DefaultJoinTokens
+template <const auto& kArray,
+          const auto& kTokens = detail::DefaultJoinTokens<
+              detail::ArrayCharType<decltype(kArray)>>::value>
+[[nodiscard]] constexpr auto FixedArrayJoin() noexcept {
+  using CharType = detail::ArrayCharType<decltype(kArray)>;
+  using view_type = std::basic_string_view<CharType>;
+  constexpr size_t length = [] {
+    size_t size = kTokens.head.size() + kTokens.tail.size();
+    for (size_t i = 0; i < std::size(kArray); ++i) {
+      size += view_type(kArray[i]).size();
+      if (0 < i) {
+        size += kTokens.separator.size();
+      }
+    }
+    return size;
+  }();
+
+  fixed_string<CharType, length> buffer;
+  size_t pos = 0;
+  const auto append = [&buffer, &pos](view_type s) {
+    for (const CharType c : s) {
+      buffer.chars[pos++] = c;
+    }
+  };
+  append(kTokens.head);
+  for (size_t i = 0; i < std::size(kArray); ++i) {
+    if (0 < i) {
+      append(kTokens.separator);
+    }
+    append(view_type(kArray[i]));
+  }
+  append(kTokens.tail);
+  return buffer;
+}
+#pragma endregion
+
+#pragma region "FixedSplit"
+// 编译期切分，空字段规则同 Split，返回指向 kSource 的 view 数组：
+//   static constexpr std::string_view kHeaders = "Host,Accept,Cookie";
+//   constexpr auto kNames = FixedSplit<kHeaders, ','>();
+// kSeparator 是字符，或者指向静态字符数组的指针
+template <const auto& kSource, auto kSeparator>
+[[nodiscard]] constexpr auto FixedSplit() noexcept {
+  using CharType = typename decltype(detail::ToStringView(kSource))::value_type;
+  constexpr size_t count = [] {
+    size_t size = 0;
+    for (const auto& e : SplitView(kSource, kSeparator)) {
+      static_cast<void>(e);
+      ++size;
+    }
+    return size;
+  }();
+
+  std::array<std::basic_string_view<CharType>, count> container{};
+  size_t i = 0;
+  for (const auto& e : SplitView(kSource, kSeparator)) {
+    container[i++] = e;
+  }
+  return container;
+}
 #pragma endregion
 
 #pragma region "Trim"
 template <class StringType>
 inline StringType Trim(StringType& str) {
-  typename StringType::size_type pos = str.find_last_not_of(' ');
+  using CharType = typename StringType::value_type;
+  constexpr CharType space[] = {' '};
+  const simd::CharSet<CharType> space_set(
+      std::basic_string_view<CharType>(space, 1));
+  typename StringType::size_type pos = simd::FindLastNotOf(
+      std::basic_string_view<CharType>(str.data(), str.size()), space_set);
   if (pos == StringType::npos) {
     str.clear();
   } else {
     str.erase(pos + 1);
-    pos = str.find_first_not_of(' ');
+    pos = simd::FindFirstNotOf(
+        std::basic_string_view<CharType>(str.data(), str.size()), space_set);
     if (0 < pos) {
       str.erase(0, pos);
     }
@@ -236,5 +619,323 @@ inline StringType Trim(StringType& str) {
   return str;
 }
 #pragma endregion
+
+#pragma region "CaseInsensitive"
+// 不区分大小写的比较和查找，按 Unicode 简单大小写折叠（见 case_fold.h）。
+// char 按 UTF-8、2 字节字符按 UTF-16、4 字节字符按 UTF-32 解码，
+// 非法单元只和相同的非法单元相等。纯 ASCII 的部分用 SSE2 逐块处理，不分配内存。
+// K（U+212A）、ſ（U+017F）等字符折叠后编码长度会变，
+// 所以匹配到的长度不一定等于 pattern 的长度
+namespace detail {
+template <typename CharType>
+inline char32_t NextFoldedChar(const CharType*& p,
+                               const CharType* last) noexcept {
+  const auto unit = static_cast<std::make_unsigned_t<CharType>>(*p);
+  if (unit < 0x80) {
+    ++p;
+    return ('A' <= unit && unit <= 'Z') ? unit + 0x20 : unit;
+  }
+  const char32_t c = encoding::NextCodePoint(p, last);
+  if (encoding::kInvalidCodePoint == c) {
+    // 挪到合法字符的范围之外
+    return 4 == sizeof(CharType) ? static_cast<char32_t>(unit)
+                                 : 0x110000 + static_cast<char32_t>(unit);
+  }
+  return FoldCase(c);
+}
+
+#if UMU_SIMD_X86
+template <typename CharType>
+struct AsciiLanes {
+  static constexpr size_t kCount = 16 / sizeof(CharType);
+
+  static __m128i Load(const CharType* p) noexcept {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+
+  static __m128i Set(uint32_t c) noexcept {
+    if constexpr (1 == sizeof(CharType)) {
+      return _mm_set1_epi8(static_cast<char>(c));
+    } else if constexpr (2 == sizeof(CharType)) {
+      return _mm_set1_epi16(static_cast<short>(c));
+    } else {
+      return _mm_set1_epi32(static_cast<int>(c));
+    }
+  }
+
+  static __m128i Equal(__m128i a, __m128i b) noexcept {
+    if constexpr (1 == sizeof(CharType)) {
+      return _mm_cmpeq_epi8(a, b);
+    } else if constexpr (2 == sizeof(CharType)) {
+      return _mm_cmpeq_epi16(a, b);
+    } else {
+      return _mm_cmpeq_epi32(a, b);
+    }
+  }
+
+  // 非 ASCII 的元素全 1
+  static __m128i NonAscii(__m128i v) noexcept {
+    if constexpr (1 == sizeof(CharType)) {
+      return _mm_cmplt_epi8(v, _mm_setzero_si128());
+    } else {
+      return _mm_xor_si128(
+          Equal(_mm_and_si128(v, Set(~0x7FU)), _mm_setzero_si128()),
+          _mm_set1_epi8(-1));
+    }
+  }
+
+  // 'A'..'Z' 变小写：加偏移后按有符号比较，落在最小的 26 个值里即是大写
+  static __m128i ToLower(__m128i v) noexcept {
+    constexpr uint32_t kBits = 8 * sizeof(CharType);
+    constexpr uint32_t kBias = 1U << (kBits - 1);
+    const __m128i t = Add(v, Set(kBias - 'A'));
+    __m128i upper;
+    if constexpr (1 == sizeof(CharType)) {
+      upper = _mm_cmplt_epi8(t, Set(kBias + 26));
+    } else if constexpr (2 == sizeof(CharType)) {
+      upper = _mm_cmplt_epi16(t, Set(kBias + 26));
+    } else {
+      upper = _mm_cmplt_epi32(t, Set(kBias + 26));
+    }
+    return _mm_or_si128(v, _mm_and_si128(upper, Set(0x20)));
+  }
+
+  static __m128i Add(__m128i a, __m128i b) noexcept {
+    if constexpr (1 == sizeof(CharType)) {
+      return _mm_add_epi8(a, b);
+    } else if constexpr (2 == sizeof(CharType)) {
+      return _mm_add_epi16(a, b);
+    } else {
+      return _mm_add_epi32(a, b);
+    }
+  }
+};
+#endif
+
+// a、b 开头都是 ASCII 且不区分大小写相等的单元数，按块计，剩下的交给标量
+template <typename CharType>
+inline size_t AsciiCaseEqualPrefix(const CharType* a,
+                                   const CharType* b,
+                                   size_t size) noexcept {
+  size_t i = 0;
+#if UMU_SIMD_X86
+  using Lanes = AsciiLanes<CharType>;
+  for (; i + Lanes::kCount <= size; i += Lanes::kCount) {
+    const __m128i x = Lanes::Load(a + i);
+    const __m128i y = Lanes::Load(b + i);
+    const __m128i bad = _mm_or_si128(
+        Lanes::NonAscii(_mm_or_si128(x, y)),
+        _mm_xor_si128(Lanes::Equal(Lanes::ToLower(x), Lanes::ToLower(y)),
+                      _mm_set1_epi8(-1)));
+    if (0 != _mm_movemask_epi8(bad)) {
+      break;
+    }
+  }
+#endif
+  return i;
+}
+
+// 从 p 开始逐字符比较，pattern 先结束则匹配
+template <typename CharType>
+inline bool StartsWithFolded(const CharType* p,
+                             const CharType* last,
+                             std::basic_string_view<CharType> pattern) noexcept {
+  const CharType* q = pattern.data();
+  const CharType* const q_last = q + pattern.size();
+  const size_t same = AsciiCaseEqualPrefix(
+      p, q, std::min<size_t>(last - p, pattern.size()));
+  p += same;
+  q += same;
+  while (q < q_last) {
+    if (p == last || NextFoldedChar(p, last) != NextFoldedChar(q, q_last)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 可能是匹配起点的位置：等于 lower/upper，或者是非 ASCII（可能折叠成 ASCII）
+template <typename CharType>
+inline const CharType* FindCaseCandidate(const CharType* p,
+                                         const CharType* last,
+                                         CharType lower,
+                                         CharType upper) noexcept {
+#if UMU_SIMD_X86
+  using Lanes = AsciiLanes<CharType>;
+  const __m128i l = Lanes::Set(static_cast<uint32_t>(lower));
+  const __m128i u = Lanes::Set(static_cast<uint32_t>(upper));
+  for (; last - p >= static_cast<ptrdiff_t>(Lanes::kCount);
+       p += Lanes::kCount) {
+    const __m128i v = Lanes::Load(p);
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_or_si128(_mm_or_si128(Lanes::Equal(v, l), Lanes::Equal(v, u)),
+                     Lanes::NonAscii(v))));
+    if (0 != mask) {
+      return p + simd::detail::CountTrailingZeros(mask) / sizeof(CharType);
+    }
+  }
+#endif
+  for (; p < last; ++p) {
+    if (lower == *p || upper == *p ||
+        static_cast<std::make_unsigned_t<CharType>>(*p) >= 0x80) {
+      return p;
+    }
+  }
+  return last;
+}
+
+// 反向版本，没有则返回 nullptr
+template <typename CharType>
+inline const CharType* FindLastCaseCandidate(const CharType* first,
+                                             const CharType* p,
+                                             CharType lower,
+                                             CharType upper) noexcept {
+#if UMU_SIMD_X86
+  using Lanes = AsciiLanes<CharType>;
+  const __m128i l = Lanes::Set(static_cast<uint32_t>(lower));
+  const __m128i u = Lanes::Set(static_cast<uint32_t>(upper));
+  for (; p - first >= static_cast<ptrdiff_t>(Lanes::kCount);
+       p -= Lanes::kCount) {
+    const __m128i v = Lanes::Load(p - Lanes::kCount);
+    const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_or_si128(_mm_or_si128(Lanes::Equal(v, l), Lanes::Equal(v, u)),
+                     Lanes::NonAscii(v))));
+    if (0 != mask) {
+      return p - Lanes::kCount +
+             simd::detail::HighestBit(mask) / sizeof(CharType);
+    }
+  }
+#endif
+  while (p > first) {
+    --p;
+    if (lower == *p || upper == *p ||
+        static_cast<std::make_unsigned_t<CharType>>(*p) >= 0x80) {
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+// pattern 第一个字符对应的候选值，非 ASCII 时只有非 ASCII 的位置可能匹配
+template <typename CharType>
+inline void CaseCandidates(std::basic_string_view<CharType> pattern,
+                           CharType* lower,
+                           CharType* upper) noexcept {
+  const CharType* p = pattern.data();
+  const char32_t first = NextFoldedChar(p, p + pattern.size());
+  if (first < 0x80) {
+    *lower = static_cast<CharType>(first);
+    *upper = static_cast<CharType>(
+        ('a' <= first && first <= 'z') ? first - 0x20 : first);
+  } else {
+    *lower = *upper = static_cast<CharType>(0x80);
+  }
+}
+
+template <typename CharType>
+inline size_t IFind(std::basic_string_view<CharType> source,
+                    std::basic_string_view<CharType> pattern,
+                    size_t pos) noexcept {
+  if (pos > source.size()) {
+    return std::basic_string_view<CharType>::npos;
+  }
+  if (pattern.empty()) {
+    return pos;
+  }
+  CharType lower;
+  CharType upper;
+  CaseCandidates(pattern, &lower, &upper);
+  const CharType* const last = source.data() + source.size();
+  for (const CharType* p = source.data() + pos;; ++p) {
+    p = FindCaseCandidate(p, last, lower, upper);
+    if (p == last) {
+      return std::basic_string_view<CharType>::npos;
+    }
+    if (StartsWithFolded(p, last, pattern)) {
+      return p - source.data();
+    }
+  }
+}
+
+template <typename CharType>
+inline size_t IRFind(std::basic_string_view<CharType> source,
+                     std::basic_string_view<CharType> pattern,
+                     size_t pos) noexcept {
+  if (pattern.empty()) {
+    return std::min(pos, source.size());
+  }
+  CharType lower;
+  CharType upper;
+  CaseCandidates(pattern, &lower, &upper);
+  if (source.empty()) {
+    return std::basic_string_view<CharType>::npos;
+  }
+  const CharType* const first = source.data();
+  const CharType* const last = first + source.size();
+  const CharType* p = first + std::min(pos, source.size() - 1) + 1;
+  for (;;) {
+    p = FindLastCaseCandidate(first, p, lower, upper);
+    if (nullptr == p) {
+      return std::basic_string_view<CharType>::npos;
+    }
+    if (StartsWithFolded(p, last, pattern)) {
+      return p - first;
+    }
+  }
+}
+}  // namespace detail
+
+template <class StringType1, class StringType2>
+[[nodiscard]] inline bool IEquals(const StringType1& a,
+                                  const StringType2& b) noexcept {
+  const auto x = detail::ToStringView(a);
+  const auto y = detail::ToStringView(b);
+  using CharType = typename decltype(x)::value_type;
+  static_assert(std::is_same_v<CharType, typename decltype(y)::value_type>);
+  // UTF-32 一个单元一个字符，长度不同一定不相等
+  if (4 == sizeof(CharType) && x.size() != y.size()) {
+    return false;
+  }
+  const size_t same = detail::AsciiCaseEqualPrefix(
+      x.data(), y.data(), std::min(x.size(), y.size()));
+  const CharType* p = x.data() + same;
+  const CharType* q = y.data() + same;
+  const CharType* const p_last = x.data() + x.size();
+  const CharType* const q_last = y.data() + y.size();
+  while (p < p_last && q < q_last) {
+    if (detail::NextFoldedChar(p, p_last) !=
+        detail::NextFoldedChar(q, q_last)) {
+      return false;
+    }
+  }
+  return p == p_last && q == q_last;
+}
+
+template <class StringType, class PrefixType>
+[[nodiscard]] inline bool IStartsWith(const StringType& s,
+                                      const PrefixType& prefix) noexcept {
+  const auto x = detail::ToStringView(s);
+  return detail::StartsWithFolded(x.data(), x.data() + x.size(),
+                                  detail::ToStringView(prefix));
+}
+
+// 返回第一个匹配的起点，没有则返回 npos
+template <class StringType, class PatternType>
+[[nodiscard]] inline size_t IFind(const StringType& source,
+                                  const PatternType& pattern,
+                                  size_t pos = 0) noexcept {
+  return detail::IFind(detail::ToStringView(source),
+                       detail::ToStringView(pattern), pos);
+}
+
+// 返回起点不大于 pos 的最后一个匹配的起点，没有则返回 npos
+template <class StringType, class PatternType>
+[[nodiscard]] inline size_t IRFind(const StringType& source,
+                                   const PatternType& pattern,
+                                   size_t pos = std::string_view::npos) noexcept {
+  return detail::IRFind(detail::ToStringView(source),
+                        detail::ToStringView(pattern), pos);
+}
+#pragma endregion
 }  // end of namespace string
 }  // end of namespace umu
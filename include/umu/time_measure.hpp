@@ -1,27 +1,190 @@
-#pragma once
+﻿#pragma once
 
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+    defined(__i386__)
+#define UMU_HAS_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+// 计时时钟：
+//   Start/Stop 读当前 tick，Stop - Start 即区间长度；
+//   ToNanoseconds 把 tick 数换算成纳秒。
+// MonotonicClock: clock_gettime(CLOCK_MONOTONIC)，tick 就是纳秒
+// QpcClock: QueryPerformanceCounter
+// TscClock: rdtsc，首次换算时用系统时钟校准频率，约 10ms。
+//   kSerialize 为 true 时 Start 前后加 lfence、Stop 用 rdtscp，
+//   被测代码不会被乱序执行到区间外，适合 100ns 以下的区间
 namespace umu {
-class TimeMeasure {
+#if defined(_WIN32)
+class QpcClock {
  public:
-  TimeMeasure(uint64_t& result) : save_(result) {
-    QueryPerformanceCounter(&start_time_);
-  }
-
-  ~TimeMeasure() {
+  static uint64_t Start() noexcept {
     LARGE_INTEGER time;
     QueryPerformanceCounter(&time);
-    save_ = time.QuadPart - start_time_.QuadPart;
+    return time.QuadPart;
   }
 
-  static uint64_t Delta(uint64_t ts) {
-    LARGE_INTEGER time;
-    QueryPerformanceCounter(&time);
+  static uint64_t Stop() noexcept { return Start(); }
+
+  static uint64_t Frequency() noexcept {
+    static const uint64_t frequency = [] {
+      LARGE_INTEGER frequency;
+      QueryPerformanceFrequency(&frequency);
+      return static_cast<uint64_t>(frequency.QuadPart);
+    }();
+    return frequency;
+  }
+
+  static uint64_t ToNanoseconds(uint64_t ticks) noexcept {
+    const uint64_t frequency = Frequency();
+    // 分两段乘，避免 ticks * 1e9 溢出
+    return ticks / frequency * 1000000000 +
+           ticks % frequency * 1000000000 / frequency;
+  }
+};
+
+using SystemClock = QpcClock;
+#else
+class MonotonicClock {
+ public:
+  static uint64_t Start() noexcept {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+  }
+
+  static uint64_t Stop() noexcept { return Start(); }
+
+  static constexpr uint64_t Frequency() noexcept { return 1000000000; }
+
+  static constexpr uint64_t ToNanoseconds(uint64_t ticks) noexcept {
+    return ticks;
+  }
+};
+
+using SystemClock = MonotonicClock;
+#endif
+
+#if UMU_HAS_TSC
+template <bool kSerialize = false>
+class TscClock {
+ public:
+  static uint64_t Start() noexcept {
+    if constexpr (kSerialize) {
+      _mm_lfence();
+      const uint64_t tsc = __rdtsc();
+      _mm_lfence();
+      return tsc;
+    } else {
+      return __rdtsc();
+    }
+  }
+
+  static uint64_t Stop() noexcept {
+    if constexpr (kSerialize) {
+      unsigned int aux;
+      const uint64_t tsc = __rdtscp(&aux);
+      _mm_lfence();
+      return tsc;
+    } else {
+      return __rdtsc();
+    }
+  }
+
+  // 每秒 tick 数
+  static uint64_t Frequency() noexcept {
+    return static_cast<uint64_t>(1e9 / NanosecondsPerTick());
+  }
+
+  static uint64_t ToNanoseconds(uint64_t ticks) noexcept {
+    return static_cast<uint64_t>(static_cast<double>(ticks) *
+                                 NanosecondsPerTick());
+  }
+
+  // 频率不随 P-state/C-state 变化，否则 tick 不能换算成时间
+  static bool IsInvariant() noexcept {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if (static_cast<unsigned int>(info[0]) < 0x80000007) {
+      return false;
+    }
+    __cpuid(info, 0x80000007);
+    return 0 != (info[3] & 0x100);
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (0 == __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+      return false;
+    }
+    return 0 != (edx & 0x100);
+#endif
+  }
 
-    return time.QuadPart - ts;
+  // 启动时调用一次可以避免第一次换算时的校准开销
+  static double NanosecondsPerTick() noexcept {
+    static const double nanoseconds_per_tick = Calibrate();
+    return nanoseconds_per_tick;
+  }
+
+ private:
+  static double Calibrate() noexcept {
+    const uint64_t start_time = SystemClock::Start();
+    const uint64_t start_tsc = TscClock<true>::Start();
+    uint64_t elapsed;
+    do {
+      elapsed = SystemClock::ToNanoseconds(SystemClock::Stop() - start_time);
+    } while (elapsed < 10000000);
+    const uint64_t ticks = TscClock<true>::Stop() - start_tsc;
+    elapsed = SystemClock::ToNanoseconds(SystemClock::Stop() - start_time);
+    return static_cast<double>(elapsed) / static_cast<double>(ticks);
+  }
+};
+#endif
+
+// 析构时把经过的 tick 数写入 result，用 Clock::ToNanoseconds 换算
+template <class Clock>
+class BasicTimeMeasure {
+ public:
+  using clock_type = Clock;
+
+  explicit BasicTimeMeasure(uint64_t& result) noexcept
+      : save_(result), start_time_(Clock::Start()) {}
+
+  ~BasicTimeMeasure() { save_ = Clock::Stop() - start_time_; }
+
+  static uint64_t Now() noexcept { return Clock::Start(); }
+
+  static uint64_t Delta(uint64_t ts) noexcept { return Clock::Stop() - ts; }
+
+  static uint64_t ToNanoseconds(uint64_t ticks) noexcept {
+    return Clock::ToNanoseconds(ticks);
   }
 
  private:
   uint64_t& save_;
-  LARGE_INTEGER start_time_;
+  // 放在最后，构造时最后读时钟
+  uint64_t start_time_;
+
+  BasicTimeMeasure(const BasicTimeMeasure&) = delete;
+  BasicTimeMeasure& operator=(const BasicTimeMeasure&) = delete;
 };
-}  // namespace umu
\ No newline at end of file
+
+using TimeMeasure = BasicTimeMeasure<SystemClock>;
+#if UMU_HAS_TSC
+using TscTimeMeasure = BasicTimeMeasure<TscClock<false>>;
+using SerializedTscTimeMeasure = BasicTimeMeasure<TscClock<true>>;
+#endif
+}  // namespace umu
@@ -1,9 +1,33 @@
-// unnecessary to include this header directly.
+﻿// unnecessary to include this header directly.
 // Designed to support C++17 or later, but only tested under C++20.
 #pragma once
 
+// 非 MSVC 下补上用到的 SAL 注解，可移植的头文件可以直接编译
+#if !defined(_MSC_VER)
+#ifndef _In_opt_
+#define _In_opt_
+#endif
+#ifndef _In_opt_z_
+#define _In_opt_z_
+#endif
+#ifndef _Out_opt_
+#define _Out_opt_
+#endif
+#endif
+
+// MSVC 不加 /Zc:__cplusplus 时 __cplusplus 恒为 199711L，要看 _MSVC_LANG
+#ifndef UMU_HAS_CXX20
+#if defined(_MSVC_LANG) && _MSVC_LANG >= 202002L
+#define UMU_HAS_CXX20 1
+#elif __cplusplus >= 202002L
+#define UMU_HAS_CXX20 1
+#else
+#define UMU_HAS_CXX20 0
+#endif
+#endif
+
 #ifndef CONSTEXPR
-#if _HAS_CXX20
+#if UMU_HAS_CXX20
 #define CONSTEXPR constexpr
 #else
 #define CONSTEXPR
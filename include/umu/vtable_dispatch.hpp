@@ -0,0 +1,297 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "memory.h"
+
+// 虚函数去虚化：从成员函数指针算出 vtable 槽位（只算一次），
+// 按对象的 vtable 取出函数地址直接调用。
+//   Itanium ABI（GCC/Clang）：虚成员函数指针里存的就是槽位偏移
+//   MSVC ABI：虚成员函数指针指向 vcall thunk，解码其中的 jmp [reg+disp]
+// 限制：只支持单继承链上的虚函数（this 不需要调整），
+// 返回值必须是 void、标量或引用（MSVC 的成员函数按值返回类时约定不同）。
+// 槽位解析失败时退回普通的 (object->*method)(args...)
+namespace umu {
+namespace memory {
+constexpr size_t kInvalidVTableSlot = SIZE_MAX;
+
+namespace detail {
+template <class Method>
+struct MemberFunctionTraits;
+
+#if defined(_M_IX86)
+// x86 MSVC 成员函数是 thiscall（this 在 ecx），用 fastcall 的第一个参数
+// 传 this，第二个参数（edx）空着
+#define UMU_VTABLE_FUNCTION_TYPE(R, C, A) R(__fastcall*)(C*, void*, A...)
+#else
+#define UMU_VTABLE_FUNCTION_TYPE(R, C, A) R (*)(C*, A...)
+#endif
+
+#define UMU_VTABLE_MEMBER_TRAITS(CV, NOEXCEPT)                          \
+  template <class R, class C, class... A>                               \
+  struct MemberFunctionTraits<R (C::*)(A...) CV NOEXCEPT> {             \
+    using Class = C;                                                    \
+    using Object = CV C;                                                \
+    using Result = R;                                                   \
+    using Function = UMU_VTABLE_FUNCTION_TYPE(R, CV C, A);              \
+    static constexpr bool kNoexcept = std::is_same_v<                   \
+        R (C::*)(A...) CV NOEXCEPT, R (C::*)(A...) CV noexcept>;        \
+  };
+
+UMU_VTABLE_MEMBER_TRAITS(, )
+UMU_VTABLE_MEMBER_TRAITS(const, )
+UMU_VTABLE_MEMBER_TRAITS(, noexcept)
+UMU_VTABLE_MEMBER_TRAITS(const, noexcept)
+#undef UMU_VTABLE_MEMBER_TRAITS
+#undef UMU_VTABLE_FUNCTION_TYPE
+
+template <class Function, class Object, class... Args>
+inline decltype(auto) CallVTableFunction(Function fn,
+                                         Object* object,
+                                         Args&&... args) {
+#if defined(_M_IX86)
+  return fn(object, nullptr, std::forward<Args>(args)...);
+#else
+  return fn(object, std::forward<Args>(args)...);
+#endif
+}
+
+#if defined(_MSC_VER)
+// 解码 vcall thunk：
+//   [jmp rel32]*                  增量链接的跳转
+//   mov rax, [rcx]                x64: 48 8B 01, x86: 8B 01
+//   jmp [rax + disp]              FF 20 / FF 60 d8 / FF A0 d32
+//   或 mov rax, [rax + disp]      /guard:cf 时先取出函数地址再经 guard 跳转
+inline size_t DecodeVCallThunk(const uint8_t* p) noexcept {
+  while (0xE9 == p[0]) {
+    int32_t rel;
+    std::memcpy(&rel, p + 1, sizeof(rel));
+    p += 5 + rel;
+  }
+#if defined(_M_X64)
+  if (0x48 != p[0] || 0x8B != p[1] || 0x01 != p[2]) {
+    return kInvalidVTableSlot;
+  }
+  p += 3;
+  if (0x48 == p[0] && 0x8B == p[1]) {
+    ++p;
+  }
+#elif defined(_M_IX86)
+  if (0x8B != p[0] || 0x01 != p[1]) {
+    return kInvalidVTableSlot;
+  }
+  p += 2;
+#else
+  return kInvalidVTableSlot;
+#endif
+  if (0xFF != p[0] && 0x8B != p[0]) {
+    return kInvalidVTableSlot;
+  }
+  int32_t offset;
+  switch (p[1]) {
+    case 0x00:  // mov rax, [rax]
+    case 0x20:  // jmp [rax]
+      offset = 0;
+      break;
+    case 0x40:
+    case 0x60:
+      offset = static_cast<int8_t>(p[2]);
+      break;
+    case 0x80:
+    case 0xA0:
+      std::memcpy(&offset, p + 2, sizeof(offset));
+      break;
+    default:
+      return kInvalidVTableSlot;
+  }
+  if (offset < 0 || 0 != offset % sizeof(void*)) {
+    return kInvalidVTableSlot;
+  }
+  return static_cast<size_t>(offset) / sizeof(void*);
+}
+#endif
+}  // namespace detail
+
+// method 必须是虚函数，否则返回 kInvalidVTableSlot
+template <class Method>
+[[nodiscard]] inline size_t VTableSlot(Method method) noexcept {
+  static_assert(std::is_member_function_pointer_v<Method>);
+#if defined(_MSC_VER)
+  const uint8_t* code;
+  std::memcpy(&code, &method, sizeof(code));
+  return detail::DecodeVCallThunk(code);
+#else
+  // Itanium ABI: {ptr, adj}
+  struct {
+    uintptr_t ptr;
+    ptrdiff_t adj;
+  } representation;
+  static_assert(sizeof(representation) == sizeof(method));
+  std::memcpy(&representation, &method, sizeof(representation));
+#if defined(__arm__) || defined(__aarch64__)
+  // ARM 上虚函数标志在 adj 的最低位
+  if (0 == (representation.adj & 1) || 0 != (representation.adj >> 1)) {
+    return kInvalidVTableSlot;
+  }
+  return representation.ptr / sizeof(void*);
+#else
+  if (0 == (representation.ptr & 1) || 0 != representation.adj) {
+    return kInvalidVTableSlot;
+  }
+  return (representation.ptr - 1) / sizeof(void*);
+#endif
+#endif
+}
+
+// object 的 vtable 指针，用来区分动态类型
+template <class Class>
+[[nodiscard]] inline const void* VTableOf(const Class* object) noexcept {
+  static_assert(std::is_polymorphic_v<Class>);
+  return *reinterpret_cast<const void* const*>(object);
+}
+
+// 单个虚函数，缓存槽位和最近一次的 (vtable, 函数地址)，
+// 同一动态类型连续调用时只比较一次 vtable 指针：
+//   umu::memory::VirtualFunction<&Plugin::Process> process;
+//   for (Plugin* p : plugins) process(p, frame);
+template <auto kMethod>
+class VirtualFunction {
+ public:
+  using Traits = detail::MemberFunctionTraits<decltype(kMethod)>;
+  using Class = typename Traits::Class;
+  using Object = typename Traits::Object;
+  using Result = typename Traits::Result;
+  using Function = typename Traits::Function;
+
+  static_assert(std::is_polymorphic_v<Class>);
+  static_assert(std::is_void_v<Result> || std::is_scalar_v<Result> ||
+                std::is_reference_v<Result>);
+
+  // 全局只解析一次
+  [[nodiscard]] static size_t slot() noexcept {
+    static const size_t slot = VTableSlot(kMethod);
+    return slot;
+  }
+
+  // object 动态类型的实现，无法解析时返回 nullptr
+  [[nodiscard]] static Function Resolve(Object* object) noexcept {
+    const size_t index = slot();
+    if (kInvalidVTableSlot == index) {
+      return nullptr;
+    }
+    return reinterpret_cast<Function>(
+        GetVTableFunctionAddress(const_cast<Class*>(object), index));
+  }
+
+  // fn 必须是 Resolve 对同一动态类型返回的值
+  template <class... Args>
+  static Result Invoke(Function fn, Object* object, Args&&... args) noexcept(
+      Traits::kNoexcept) {
+    if (nullptr == fn) {
+      return (object->*kMethod)(std::forward<Args>(args)...);
+    }
+    return detail::CallVTableFunction(fn, object, std::forward<Args>(args)...);
+  }
+
+  template <class... Args>
+  Result operator()(Object* object, Args&&... args) noexcept(
+      Traits::kNoexcept) {
+    const void* vtable = VTableOf(object);
+    if (vtable != vtable_) {
+      vtable_ = vtable;
+      function_ = Resolve(object);
+    }
+    return Invoke(function_, object, std::forward<Args>(args)...);
+  }
+
+ private:
+  const void* vtable_ = nullptr;
+  Function function_ = nullptr;
+};
+
+// 一组虚函数在同一动态类型上的实现，构造时一次解析：
+//   umu::memory::DispatchTable<&Plugin::Begin, &Plugin::Process> table(p);
+//   table.Call<1>(p, frame);
+template <auto... kMethods>
+class DispatchTable {
+ public:
+  template <size_t I>
+  using Method =
+      VirtualFunction<std::get<I>(std::make_tuple(kMethods...))>;
+
+  template <class Object>
+  explicit DispatchTable(Object* object) noexcept
+      : vtable_(VTableOf(object)),
+        functions_{reinterpret_cast<void*>(
+            VirtualFunction<kMethods>::Resolve(object))...} {}
+
+  [[nodiscard]] const void* vtable() const noexcept { return vtable_; }
+
+  // object 的动态类型必须和构造时的相同
+  template <size_t I, class Object, class... Args>
+  decltype(auto) Call(Object* object, Args&&... args) const {
+    using F = Method<I>;
+    return F::Invoke(reinterpret_cast<typename F::Function>(functions_[I]),
+                     object, std::forward<Args>(args)...);
+  }
+
+ private:
+  const void* vtable_;
+  void* functions_[sizeof...(kMethods)];
+};
+
+// 批量调用：把对象数组按 vtable 分组，每组解析一次，组内连续直接调用，
+// 间接跳转的目标在组内不变，分支预测几乎不失败。
+// 调用顺序按组重排，组内保持原顺序；内部缓冲可复用，稳定后不再分配内存
+//   umu::memory::BatchDispatcher<&Plugin::Process> dispatcher;
+//   dispatcher.Dispatch(plugins.data(), plugins.size(), frame);
+template <auto kMethod>
+class BatchDispatcher {
+ public:
+  using Function = VirtualFunction<kMethod>;
+  using Object = typename Function::Object;
+
+  template <class... Args>
+  void Dispatch(Object* const* objects, size_t count, const Args&... args) {
+    entries_.clear();
+    entries_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      entries_.push_back({VTableOf(objects[i]), objects[i], i});
+    }
+    // 按 (vtable, 原下标) 排序，效果同 stable_sort，但不需要临时缓冲
+    std::sort(entries_.begin(), entries_.end(),
+              [](const Entry& a, const Entry& b) {
+                return a.vtable != b.vtable
+                           ? std::less<const void*>()(a.vtable, b.vtable)
+                           : a.index < b.index;
+              });
+    for (size_t begin = 0; begin < entries_.size();) {
+      const void* vtable = entries_[begin].vtable;
+      const auto fn = Function::Resolve(entries_[begin].object);
+      size_t end = begin;
+      for (; end < entries_.size() && entries_[end].vtable == vtable; ++end) {
+        Function::Invoke(fn, entries_[end].object, args...);
+      }
+      begin = end;
+    }
+  }
+
+ private:
+  struct Entry {
+    const void* vtable;
+    Object* object;
+    size_t index;
+  };
+
+  std::vector<Entry> entries_;
+};
+}  // namespace memory
+}  // end of namespace umu
@@ -0,0 +1,123 @@
+// binary_log.hpp 的回归测试：写入端环形缓冲多次回绕，解码后和 snprintf 的结果逐行比较；
+// 损坏的文件 Decoder 必须返回 false。
+//   cmake -S tests -B build/tests
+//   cmake --build build/tests
+//   ctest --test-dir build/tests --output-on-failure
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "umu/binary_log.hpp"
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,     \
+                   __LINE__, #condition);                             \
+      std::exit(1);                                                   \
+    }                                                                 \
+  } while (false)
+
+namespace {
+std::string ReadFile(const char* path) {
+  std::string data;
+  std::FILE* file = std::fopen(path, "rb");
+  CHECK(nullptr != file);
+  char buffer[1 << 16];
+  for (size_t size; 0 != (size = std::fread(buffer, 1, sizeof(buffer), file));) {
+    data.append(buffer, size);
+  }
+  std::fclose(file);
+  return data;
+}
+
+// 去掉 "时间 [线程] " 前缀
+std::vector<std::string> Messages(std::string_view text) {
+  std::vector<std::string> messages;
+  while (!text.empty()) {
+    const size_t end = text.find('\n');
+    CHECK(std::string_view::npos != end);
+    const std::string_view line = text.substr(0, end);
+    const size_t start = line.find("] ");
+    CHECK(std::string_view::npos != start);
+    messages.emplace_back(line.substr(start + 2));
+    text.remove_prefix(end + 1);
+  }
+  return messages;
+}
+
+// 记录长度 32 到几百字节不等，每批不超过缓冲的一半，缓冲末尾的各种剩余长度都会遇到
+void TestWrapRoundTrip(const char* path) {
+  auto& logger = umu::BinaryLogger::Instance();
+  CHECK(logger.Open(path));
+  std::vector<std::string> expected;
+  const std::string filler(300, 'x');
+  char line[512];
+  for (int i = 0; i < 60000; ++i) {
+    const std::string_view text(filler.data(), i * 7 % 301);
+    if (0 == i % 3) {
+      UMU_BINARY_LOG("x\n");
+      expected.emplace_back("x");
+    } else {
+      UMU_BINARY_LOG("%d [%s] %.2f %u\n", i, text, i / 4.0, 7u);
+      std::snprintf(line, sizeof(line), "%d [%.*s] %.2f %u", i,
+                    static_cast<int>(text.size()), text.data(), i / 4.0, 7u);
+      expected.emplace_back(line);
+    }
+    if (0 == i % 1000) {
+      logger.Flush();
+    }
+  }
+  logger.Close();
+  CHECK(0 == logger.dropped());
+
+  const std::string data = ReadFile(path);
+  umu::binary_log::Decoder decoder;
+  std::string text;
+  // 按不对齐的小块喂入，覆盖跨块的记录
+  for (size_t offset = 0; offset < data.size(); offset += 4093) {
+    CHECK(decoder.Feed(std::string_view(data).substr(offset, 4093), &text));
+  }
+  CHECK(decoder.Finish());
+  CHECK(0 == decoder.dropped());
+  CHECK(Messages(text) == expected);
+}
+
+void TestCorruptSite() {
+  std::string data(umu::binary_log::kMagic,
+                   sizeof(umu::binary_log::kMagic) - 1);
+  umu::binary_log::detail::AppendPod(&data, uint64_t{0});
+  data.push_back(static_cast<char>(umu::binary_log::Chunk::kSite));
+  umu::binary_log::detail::AppendPod(&data, uint32_t{0xFFFFFFFF});
+  umu::binary_log::detail::AppendPod(&data, uint32_t{1});
+  umu::binary_log::detail::AppendPod(&data, uint8_t{0});
+  umu::binary_log::detail::AppendText(&data, "x");
+  umu::binary_log::detail::AppendText(&data, "file");
+  umu::binary_log::Decoder decoder;
+  std::string text;
+  CHECK(!decoder.Feed(data, &text));
+  CHECK(!decoder.Finish());
+}
+
+void TestTruncated(const char* path) {
+  const std::string data = ReadFile(path);
+  umu::binary_log::Decoder decoder;
+  std::string text;
+  CHECK(decoder.Feed(std::string_view(data).substr(0, data.size() - 1),
+                     &text));
+  CHECK(!decoder.Finish());
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const char* path = 1 < argc ? argv[1] : "binary_log_test.ulog";
+  TestWrapRoundTrip(path);
+  TestCorruptSite();
+  TestTruncated(path);
+  std::remove(path);
+  std::puts("binary_log_test passed");
+  return 0;
+}
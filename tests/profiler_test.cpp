@@ -0,0 +1,78 @@
+// profiler.hpp 的回归测试：输出文件打不开时，WriteChromeTrace/WriteBinary
+// 返回 false 且不取走事件，换个能写的路径再导出，事件都还在；
+// SetThreadCapacity 之后新线程的缓冲按取整后的容量回绕。
+//   cmake -S tests -B build/tests
+//   cmake --build build/tests
+//   ctest --test-dir build/tests --output-on-failure
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "umu/profiler.hpp"
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,     \
+                   __LINE__, #condition);                             \
+      std::exit(1);                                                   \
+    }                                                                 \
+  } while (false)
+
+namespace {
+constexpr const char* kBadPath = "no-such-directory/profiler_test.out";
+
+void RecordEvents(int count) {
+  for (int i = 0; i < count; ++i) {
+    UMU_PROFILE_SCOPE("Outer");
+    UMU_PROFILE_SCOPE("Inner");
+  }
+}
+
+void TestChromeTraceOpenFailure(const std::string& path) {
+  auto& profiler = umu::Profiler::Instance();
+  std::vector<umu::ProfileRecord> records;
+  RecordEvents(10);
+  CHECK(!profiler.WriteChromeTrace(kBadPath));
+  CHECK(20 == profiler.Collect(&records));
+  RecordEvents(10);
+  CHECK(profiler.WriteChromeTrace(path.c_str()));
+  CHECK(0 == profiler.Collect(&records));
+}
+
+void TestBinaryOpenFailure(const std::string& path) {
+  auto& profiler = umu::Profiler::Instance();
+  std::vector<umu::ProfileRecord> records;
+  RecordEvents(10);
+  CHECK(!profiler.WriteBinary(kBadPath));
+  CHECK(20 == profiler.Collect(&records));
+  RecordEvents(10);
+  CHECK(profiler.WriteBinary(path.c_str()));
+  CHECK(0 == profiler.Collect(&records));
+}
+
+void TestThreadCapacity() {
+  auto& profiler = umu::Profiler::Instance();
+  profiler.SetThreadCapacity(100);
+  const uint64_t dropped = profiler.dropped();
+  std::thread([] { RecordEvents(100); }).join();
+  std::vector<umu::ProfileRecord> records;
+  CHECK(128 == profiler.Collect(&records));
+  CHECK(dropped + 72 == profiler.dropped());
+  profiler.SetThreadCapacity(umu::Profiler::kDefaultThreadCapacity);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const std::string path = 1 < argc ? argv[1] : "profiler_test.out";
+  umu::Profiler::Instance().SetEnabled(true);
+  TestChromeTraceOpenFailure(path);
+  TestBinaryOpenFailure(path);
+  TestThreadCapacity();
+  std::remove(path.c_str());
+  std::puts("profiler_test passed");
+  return 0;
+}
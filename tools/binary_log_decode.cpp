@@ -0,0 +1,54 @@
+// 把 umu::BinaryLogger 写的二进制日志转成文本：
+//   cmake -S tools -B build/tools
+//   cmake --build build/tools --config Release
+//   umu_binary_log_decode app.ulog > app.log
+// 不指定文件时读标准输入。时间是 UTC
+
+#include <cstdio>
+#include <string>
+
+#include "umu/binary_log.hpp"
+
+int main(int argc, char* argv[]) {
+  if (2 < argc) {
+    std::fprintf(stderr, "usage: %s [binary log]\n", argv[0]);
+    return 2;
+  }
+  std::FILE* input = stdin;
+  if (2 == argc) {
+    input = std::fopen(argv[1], "rb");
+    if (nullptr == input) {
+      std::perror(argv[1]);
+      return 1;
+    }
+  }
+
+  umu::binary_log::Decoder decoder;
+  std::string text;
+  char chunk[1 << 16];
+  bool ok = true;
+  for (;;) {
+    const size_t size = std::fread(chunk, 1, sizeof(chunk), input);
+    if (0 == size) {
+      break;
+    }
+    ok = decoder.Feed(std::string_view(chunk, size), &text);
+    std::fwrite(text.data(), 1, text.size(), stdout);
+    text.clear();
+    if (!ok) {
+      break;
+    }
+  }
+  if (stdin != input) {
+    std::fclose(input);
+  }
+  if (0 != decoder.dropped()) {
+    std::fprintf(stderr, "%llu records dropped\n",
+                 static_cast<unsigned long long>(decoder.dropped()));
+  }
+  if (!ok || !decoder.Finish()) {
+    std::fprintf(stderr, "truncated or corrupt binary log\n");
+    return 1;
+  }
+  return 0;
+}